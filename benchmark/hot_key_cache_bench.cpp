@@ -0,0 +1,116 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   benchmark/hot_key_cache_bench.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+/*
+ * GetValue latency with and without the hot key cache under a Zipfian load.
+ *
+ * Usage: bplustree-cache-bench [keys] [lookups] [theta] [capacity]
+ *
+ * The tree is loaded with keys 0..keys-1. Lookups draw ranks from a Zipfian
+ * distribution with the given skew and scatter them over the key space, so
+ * hot keys do not share leaves. Every configuration replays the same
+ * sequence of keys. Build with -DCMAKE_BUILD_TYPE=Release, otherwise the
+ * library is compiled without optimization.
+ */
+
+#include "../include/b_plus_tree.h"
+#include "../include/hot_key_cache.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Zipfian ranks in [0, n), as generated by YCSB (Gray et al.)
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(int n, double theta) : n(n), theta(theta) {
+        for (int i = 1; i <= n; i++) {
+            zeta_n += 1.0 / pow(i, theta);
+        }
+        double zeta_2 = 1.0 + 1.0 / pow(2, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+    }
+
+    int Next(mt19937_64 &rng) {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zeta_n;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + pow(0.5, theta)) {
+            return 1;
+        }
+        return min(n - 1, (int) (n * pow(eta * u - eta + 1, alpha)));
+    }
+
+private:
+    int n;
+    double theta;
+    double zeta_n = 0;
+    double alpha;
+    double eta;
+};
+
+// Run the lookups and return the average nanoseconds per GetValue
+double runLookups(BPlusTree &tree, const vector<int> &lookups) {
+    RecordPointer record;
+    long long found = 0;
+    auto start = chrono::steady_clock::now();
+    for (int key : lookups) {
+        found += tree.GetValue(key, record);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (found != (long long) lookups.size()) {
+        printf("ERROR: %lld of %zu keys found\n", found, lookups.size());
+    }
+    return seconds * 1e9 / lookups.size();
+}
+
+int main(int argc, char **argv) {
+    int keys = argc > 1 ? atoi(argv[1]) : 1000000;
+    int lookup_num = argc > 2 ? atoi(argv[2]) : 5000000;
+    double theta = argc > 3 ? atof(argv[3]) : 0.99;
+    int capacity = argc > 4 ? atoi(argv[4]) : keys / 100;
+
+    BPlusTree tree;
+    for (int key = 0; key < keys; key++) {
+        tree.Insert(key, RecordPointer(key, key));
+    }
+
+    // Scatter the ranks over the key space with a multiplicative permutation
+    ZipfianGenerator zipf(keys, theta);
+    mt19937_64 rng(42);
+    vector<int> lookups(lookup_num);
+    for (int &key : lookups) {
+        key = (int) ((long long) zipf.Next(rng) * 2654435761LL % keys);
+    }
+
+    printf("keys=%d lookups=%d theta=%.2f capacity=%d\n", keys, lookup_num, theta, capacity);
+    printf("%10s %12s %10s %12s\n", "cache", "ns/lookup", "hit rate", "admissions");
+
+    double baseline = runLookups(tree, lookups);
+    printf("%10s %12.1f %10s %12s\n", "off", baseline, "-", "-");
+
+    HotKeyCache cache(capacity);
+    tree.SetCache(&cache);
+    double cached = runLookups(tree, lookups);
+    HotKeyCacheStats stats;
+    cache.GetStats(stats);
+    printf("%10s %12.1f %9.1f%% %12lld\n", "on", cached, 100 * stats.HitRate(), stats.admissions);
+    printf("speedup %.2fx\n", baseline / cached);
+    return 0;
+}
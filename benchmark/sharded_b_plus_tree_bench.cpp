@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   benchmark/sharded_b_plus_tree_bench.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+/*
+ * Throughput of a single latched BPlusTree against ShardedBPlusTree.
+ *
+ * Usage: bplustree-sharded-bench [keys] [ops_per_thread] [shards]
+ *
+ * Both indexes are preloaded with the even keys of [0, 2 * keys). Every thread
+ * then runs 90% GetValue and 10% Insert of odd keys. With more than one NUMA
+ * node, each thread is pinned to a node and only touches the shards whose
+ * nodes live there.
+ */
+
+#include "../include/b_plus_tree.h"
+#include "../include/sharded_b_plus_tree.h"
+#include "../include/numa_arena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Latched single tree, the baseline we compare against
+struct SingleTree {
+    BPlusTree tree;
+    mutex latch;
+
+    bool Insert(const KeyType &key, const RecordPointer &value) {
+        lock_guard<mutex> guard(latch);
+        return tree.Insert(key, value);
+    }
+    bool GetValue(const KeyType &key, RecordPointer &result) {
+        lock_guard<mutex> guard(latch);
+        return tree.GetValue(key, result);
+    }
+};
+
+// Run ops_per_thread operations on each thread, return total ops per second
+template <typename Index>
+double runWorkload(Index &index, int threads, int keys, int ops_per_thread, int shards) {
+    int numa_nodes = NumaArena::NodeCount();
+    int key_space = 2 * keys;
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            int node = t % numa_nodes;
+            if (numa_nodes > 1) {
+                NumaArena::RunOnNode(node);
+            }
+            mt19937 rng(t + 1);
+            RecordPointer record;
+            for (int i = 0; i < ops_per_thread; i++) {
+                // Pick a shard homed on this thread's node, then a key in it
+                int shard = node + numa_nodes * (int) (rng() % max(1, shards / numa_nodes));
+                shard = min(shard, shards - 1);
+                long long low = (long long) key_space * shard / shards;
+                long long high = (long long) key_space * (shard + 1) / shards;
+                int key = (int) (low + rng() % max(1LL, high - low));
+                if (rng() % 10 == 0) {
+                    key |= 1;
+                    index.Insert(key, RecordPointer(key, key));
+                } else {
+                    index.GetValue(key & ~1, record);
+                }
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return threads * (double) ops_per_thread / seconds;
+}
+
+int main(int argc, char **argv) {
+    int keys = argc > 1 ? atoi(argv[1]) : 20000;
+    int ops_per_thread = argc > 2 ? atoi(argv[2]) : 200000;
+    int shards = argc > 3 ? atoi(argv[3]) : 8;
+    int max_threads = max(4, (int) thread::hardware_concurrency());
+
+    printf("keys=%d ops/thread=%d shards=%d numa_nodes=%d\n",
+           keys, ops_per_thread, shards, NumaArena::NodeCount());
+    printf("%8s %16s %16s %8s\n", "threads", "single ops/s", "sharded ops/s", "speedup");
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        SingleTree single;
+        ShardedBPlusTree sharded(shards, 0, 2 * keys);
+        for (int key = 0; key < 2 * keys; key += 2) {
+            single.Insert(key, RecordPointer(key, key));
+            sharded.Insert(key, RecordPointer(key, key));
+        }
+        double single_ops = runWorkload(single, threads, keys, ops_per_thread, shards);
+        double sharded_ops = runWorkload(sharded, threads, keys, ops_per_thread, shards);
+        printf("%8d %16.0f %16.0f %8.2f\n", threads, single_ops, sharded_ops, sharded_ops / single_ops);
+    }
+    return 0;
+}
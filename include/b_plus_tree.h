@@ -10,13 +10,23 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <memory>
 #include <queue>
 #include <string>
 #include <vector>
+#include "numa_arena.h"
 #include "para.h"
+#include "trace.h"
 
 using namespace std;
 
+// Defined in scan_filter.h
+struct ScanFilter;
+struct ScanColumns;
+
+// Defined in hot_key_cache.h
+class HotKeyCache;
+
 // Value structure we insert into BPlusTree
 struct RecordPointer {
     int page_id;
@@ -39,18 +49,55 @@ class InternalNode : public Node {
 public:
     InternalNode() : Node(false) {};
     Node * children[MAX_FANOUT];
+#if ORDER_STATISTICS
+    // number of keys stored in the subtree of each child
+    int child_counts[MAX_FANOUT];
+#endif
 };
 
+#if FINGERPRINT_LEAVES
+// Fingerprint slots, padded so SIMD can always load whole 16-byte chunks
+#define FINGERPRINT_SLOTS (((MAX_FANOUT - 1) + 15) / 16 * 16)
+#endif
+
 class LeafNode : public Node {
 public:
     LeafNode() : Node(true) {};
     RecordPointer pointers[MAX_FANOUT - 1];
+#if FINGERPRINT_LEAVES
+    // 1-byte hash of every key, entries [0, key_num) are in use
+    unsigned char fingerprints[FINGERPRINT_SLOTS] = {0};
+    // false once entries were appended or moved out of key order
+    bool is_sorted = true;
+#endif
     // pointer to the next/prev leaf node
     LeafNode *next_leaf = NULL;
     LeafNode *prev_leaf = NULL;
 };
 
 
+// Shape of a tree as reported by GetStats
+struct TreeStats {
+    int height = 0;
+    long long keys = 0;
+    long long leaf_nodes = 0;
+    long long internal_nodes = 0;
+    // memory used by all the nodes
+    long long node_bytes = 0;
+    // average fraction of leaf slots in use
+    double leaf_fill = 0;
+};
+
+// Work done by Compact, accumulated over calls
+struct CompactionStats {
+    long long leaves_visited = 0;
+    long long nodes_reclaimed = 0;
+    long long bytes_reclaimed = 0;
+    int height_reduction = 0;
+    // number of complete passes over the leaf chain
+    int passes = 0;
+};
+
 /**
  * Main class providing the API for the Interactive B+ Tree.
  *
@@ -60,22 +107,33 @@ public:
  * (2) Support insert & remove
  * (3) Support range scan, return multiple values.
  * (4) The structure should shrink and grow dynamically
+ * (5) Split and concatenate whole trees in O(height)
  */
 
 class BPlusTree {
 public:
     BPlusTree(){};
 
-    std::vector<std::pair<KeyType, RecordPointer>> key_value_pairs;
+    // Allocate every node of this tree on the given NUMA node
+    explicit BPlusTree(int numa_node);
+
+    // Allocate nodes from an arena shared with other trees
+    explicit BPlusTree(const std::shared_ptr<NumaArena> &arena);
+
+    // Release all the nodes owned by this tree
+    ~BPlusTree();
+
+    BPlusTree(const BPlusTree &) = delete;
+    BPlusTree &operator=(const BPlusTree &) = delete;
 
     // Returns true if this B+ tree has no keys and values
     bool IsEmpty() const;
         
-    // Insert a key-value pair into this B+ tree.
+    // Insert a key-value pair into this B+ tree, false if the key already exists.
     bool Insert(const KeyType &key, const RecordPointer &value);
 
-    // Remove a key and its value from this B+ tree.
-    void Remove(const KeyType &key);
+    // Remove a key and its value from this B+ tree, false if the key was not there.
+    bool Remove(const KeyType &key);
 
     // return the value associated with a given key
     bool GetValue(const KeyType &key, RecordPointer &result);
@@ -83,23 +141,132 @@ public:
     // return the values within a key range [key_start, key_end) not included key_end
     void RangeScan(const KeyType &key_start, const KeyType &key_end,
                     std::vector<RecordPointer> &result);
+
+    // scan [key_start, key_end) and write only the rows passing the filter
+    // into the caller's columns, returns the number of rows written
+    int FilteredScan(const KeyType &key_start, const KeyType &key_end,
+                     const ScanFilter &filter, ScanColumns &columns);
+
+    // return the number of keys smaller than the given key
+    int Rank(const KeyType &key);
+
+    // return the k-th smallest key (starting from 0) and its value
+    bool Select(const int &k, KeyType &key, RecordPointer &value);
+
+    // return the number of keys within a key range [key_start, key_end)
+    int CountRange(const KeyType &key_start, const KeyType &key_end);
+
+    // return up to limit values starting from the offset-th smallest key
+    void SelectScan(const int &offset, const int &limit, std::vector<RecordPointer> &result);
+
+    // move every key >= key into the empty tree other
+    bool SplitAt(const KeyType &key, BPlusTree &other);
+
+    // move every key of other into this tree, their key ranges must not overlap
+    bool Concatenate(BPlusTree &other);
+
+    // log every Insert/GetValue/RangeScan/Remove to the recorder, NULL to stop.
+    // The recorder is not owned by the tree.
+    void SetRecorder(TraceRecorder *recorder) { this->recorder = recorder; }
+
+    // serve GetValue of frequent keys from the cache, NULL to stop.
+    // The cache is not owned by the tree.
+    void SetCache(HotKeyCache *cache) { this->cache = cache; }
+
+    // walk the whole tree and report its shape
+    void GetStats(TreeStats &stats);
+
+    // merge under-filled nodes toward target_fill, visiting about max_leaves
+    // leaves per call and resuming where the last call stopped.
+    // returns true once a pass over the whole leaf chain is complete
+    bool Compact(const int &max_leaves, const double &target_fill, CompactionStats &stats);
     
     // pointer to the root node.
     Node *root = NULL;
 
 private:
+    // Internal nodes from the root down to a leaf, with the child index taken
+    typedef std::vector<std::pair<InternalNode*, int>> NodePath;
+
+    // Node allocator, NULL means plain new/delete
+    std::shared_ptr<NumaArena> arena;
+
+    // Optional workload recorder
+    TraceRecorder *recorder = NULL;
+
+    // Optional point lookup cache
+    HotKeyCache *cache = NULL;
+
+    // Nodes released so far, used to report what compaction reclaimed
+    long long freed_nodes = 0;
+    long long freed_bytes = 0;
+
+    // First key of the leaves compaction has not visited yet in this pass
+    KeyType compact_cursor;
+    bool compact_in_pass = false;
+
+    // Functions to allocate and release nodes through the arena
+    LeafNode* NewLeafNode();
+    InternalNode* NewInternalNode();
+    void FreeNode(Node *node);
+    void FreeSubtree(Node *node);
+
     // Function to get the leaf node for the specified key
     Node* getChildForKey(const KeyType &key);
     
     // Function to insert the new key in the leaf node
     bool InsertInLeaf(LeafNode *leaf, const KeyType &key, const RecordPointer &value);
 
-    // Function to insert the new key in the parent node
-    bool InsertInParent(const KeyType &key, InternalNode *parent_node, Node *new_node);
+    // Function to find the position of the key in the leaf, -1 if missing
+    int FindInLeaf(LeafNode *leaf, const KeyType &key);
+
+    // Functions to restore key order and hashes of unsorted leaves
+    void SortLeaf(LeafNode *leaf);
+    void RefreshFingerprints(LeafNode *leaf);
 
-    // Find the parent for the specified node
-    InternalNode* FindParent(InternalNode* root_node, InternalNode *search_node);
+    // Function to insert the new key and child into the node at path[level]
+    bool InsertInParent(const KeyType &key, NodePath &path, int level, Node *new_node, int child_pos);
+
+    // Function to find the leaf for the key and the path leading to it
+    LeafNode* FindLeaf(const KeyType &key, NodePath &path);
+
+    // Functions to fix under-filled nodes after removal
+    void RebalancePath(NodePath &path, Node *node);
+    bool FixUnderflow(InternalNode *parent_node, int idx);
+    bool CanMerge(Node *left_node, Node *right_node);
+    void MergeNodes(Node *left_node, const KeyType &separator, Node *right_node);
+    void RedistributeNodes(Node *left_node, KeyType &separator, Node *right_node);
+    void ShrinkRoot();
+
+    // Functions to pack the leaves below a node and merge sparse internal nodes
+    LeafNode* RepackLeaves(InternalNode *parent_node, int target_keys);
+    void CompactPath(NodePath &path, Node *node);
+
+    // Function to join two trees into this tree's root, returns its height
+    int Join(Node *left, int left_height, const KeyType &separator, Node *right, int right_height);
+
+    // Helpers to navigate and copy subtrees
+    int Height(Node *node);
+    LeafNode* FirstLeaf(Node *node);
+    LeafNode* LastLeaf(Node *node);
+    Node* CloneSubtree(Node *node, LeafNode *&last_leaf);
+    void CollectStats(Node *node, TreeStats &stats);
 
     // Function to find the node that contains the start key
     LeafNode* FindNode(InternalNode* curr_node, const KeyType &key_start);
+
+    // Function to find the leaf holding the k-th smallest key, k becomes the
+    // position inside that leaf. Returns NULL if there are not enough keys.
+    LeafNode* FindNodeByRank(int &k);
+
+#if ORDER_STATISTICS
+    // Number of keys stored below the node
+    int SubtreeCount(Node *node);
+
+    // Recompute the counts of every child of the node
+    void RecountNode(InternalNode *node);
+
+    // Add delta to the counts along the path
+    void UpdatePathCounts(NodePath &path, int delta);
+#endif
 };
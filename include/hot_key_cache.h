@@ -0,0 +1,125 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification:   include/hot_key_cache.h
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "b_plus_tree.h"
+#include "para.h"
+
+// Slots per bucket, a key can live in any slot of its bucket
+#define HOT_CACHE_WAYS 4
+
+// Rows of the count-min frequency sketch
+#define HOT_CACHE_SKETCH_ROWS 4
+
+// A key must have been looked up this often before it is cached
+#define HOT_CACHE_MIN_FREQUENCY 2
+
+// Hit and admission counters, accumulated since the cache was created
+struct HotKeyCacheStats {
+    long long lookups = 0;
+    long long hits = 0;
+    long long admissions = 0;
+    // lookups whose key was not frequent enough to replace a cached one
+    long long rejections = 0;
+    long long invalidations = 0;
+
+    double HitRate() const { return lookups == 0 ? 0 : (double) hits / lookups; }
+};
+
+/*
+ * Bounded cache of the RecordPointers of frequently looked up keys, meant to
+ * sit in front of the GetValue descent.
+ *
+ * Every lookup is counted in a count-min sketch whose counters are halved
+ * periodically, so it tracks recent frequency (TinyLFU). A bloom filter in
+ * front of the sketch, the doorkeeper, absorbs the first lookup of every key
+ * so keys seen once do not crowd the sketch counters. A missed key is
+ * only admitted once it was looked up HOT_CACHE_MIN_FREQUENCY times and more
+ * often than the least frequent key of its bucket, so one-off lookups do
+ * not push hot keys out. Range scans never touch the cache.
+ *
+ * Lookups and admissions are lock-free: each slot is guarded by a sequence
+ * number, a reader treats a slot being written as a miss and an admission
+ * gives up on a slot another writer holds. Only invalidation waits for a
+ * slot, so a removed key is never served again. Admissions must be
+ * serialized with the writes of the tree, as BPlusTree::GetValue is. The
+ * cache can be shared by the trees of one ShardedBPlusTree, but not by
+ * trees that may hold the same key with different values.
+ */
+class HotKeyCache {
+public:
+    // capacity is rounded up to a power of two number of slots
+    explicit HotKeyCache(size_t capacity);
+
+    HotKeyCache(const HotKeyCache &) = delete;
+    HotKeyCache &operator=(const HotKeyCache &) = delete;
+
+    // Count the lookup and return true with the value if the key is cached
+    bool Lookup(const KeyType &key, RecordPointer &value);
+
+    // Offer a key found in the tree after a missed lookup
+    void Admit(const KeyType &key, const RecordPointer &value);
+
+    // Drop the key if it is cached
+    void Invalidate(const KeyType &key);
+
+    // Drop every key
+    void Clear();
+
+    size_t Capacity() const { return slot_num; }
+
+    void GetStats(HotKeyCacheStats &stats) const;
+
+private:
+    struct Slot {
+        // odd while a writer owns the slot
+        std::atomic<unsigned int> version;
+        std::atomic<bool> valid;
+        std::atomic<KeyType> key;
+        std::atomic<int> page_id;
+        std::atomic<int> record_id;
+    };
+
+    size_t slot_num;
+    size_t bucket_mask;
+    std::unique_ptr<Slot[]> slots;
+
+    // count-min sketch with 8-bit saturating counters
+    size_t sketch_mask;
+    std::unique_ptr<std::atomic<unsigned char>[]> sketch;
+    // bloom filter of the keys looked up since the last halving
+    size_t doorkeeper_mask;
+    std::unique_ptr<std::atomic<unsigned long long>[]> doorkeeper;
+    // counters are halved every sketch_period lookups
+    long long sketch_period;
+
+    std::atomic<long long> lookups;
+    std::atomic<long long> hits;
+    std::atomic<long long> admissions;
+    std::atomic<long long> rejections;
+    std::atomic<long long> invalidations;
+
+    // Functions for the frequency sketch
+    static unsigned long long SketchHash(const KeyType &key);
+    void CountLookup(unsigned long long hash);
+    int Frequency(unsigned long long hash) const;
+    bool InDoorkeeper(size_t low, size_t high) const;
+    void AgeSketch();
+
+    // Functions to read and write one slot under its sequence number
+    bool ReadSlot(Slot &slot, KeyType &key, RecordPointer &value);
+    bool LockSlot(Slot &slot, unsigned int &version);
+    void UnlockSlot(Slot &slot, unsigned int version);
+
+    Slot *Bucket(const KeyType &key);
+};
@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification:   include/numa_arena.h
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Slab allocator for B+ tree nodes bound to one NUMA node.
+ *
+ * Nodes are tiny, so allocating each one with numa_alloc_onnode() would waste
+ * a page per node. Instead we grab large slabs on the requested NUMA node and
+ * carve nodes out of them, recycling freed nodes through per-size free lists.
+ * When the library is built without libnuma the slabs come from malloc() and
+ * the node hint is ignored. An arena may be shared by several trees, e.g.
+ * all shards on one NUMA node, so allocation is latched.
+ */
+class NumaArena {
+public:
+    explicit NumaArena(int numa_node);
+    ~NumaArena();
+
+    NumaArena(const NumaArena &) = delete;
+    NumaArena &operator=(const NumaArena &) = delete;
+
+    // Allocate size bytes of node memory on this arena's NUMA node
+    void *Allocate(size_t size);
+
+    // Return memory obtained from Allocate() with the same size
+    void Free(void *ptr, size_t size);
+
+    int NumaNode() const { return numa_node; }
+
+    // Returns true if NUMA placement is supported on this machine
+    static bool Available();
+
+    // Number of NUMA nodes, 1 if NUMA is not available
+    static int NodeCount();
+
+    // Restrict the calling thread to the CPUs of the given NUMA node
+    static bool RunOnNode(int numa_node);
+
+private:
+    int numa_node;
+    std::mutex latch;
+    // slabs we own, released in the destructor, with whether each came
+    // from libnuma or from the malloc() fallback
+    std::vector<std::pair<void *, bool>> slabs;
+    char *slab_cursor = NULL;
+    size_t slab_left = 0;
+    // (chunk size, head of the intrusive free list)
+    std::vector<std::pair<size_t, void *>> free_lists;
+};
@@ -6,3 +6,15 @@
 // The data type for keys used in the B+ tree. In this case, the keys are of type 'int'.
 // This could be modified to use other types if needed, such as float, string, etc.
 #define KeyType int
+
+// Keep the number of keys below every child of an internal node. This makes
+// Rank, Select and CountRange O(log n) instead of walking the leaves.
+// Set to 0 to drop the per-child counters from internal nodes.
+#define ORDER_STATISTICS 1
+
+// Set to 1 to store leaf entries unsorted with a 1-byte hash per key (FPTree
+// style). Inserts append instead of shifting, point lookups compare the hashes
+// with SIMD first, and leaves are sorted lazily when a split or scan needs
+// order. Only worth it with a large MAX_FANOUT: the hashes are padded to 16
+// bytes per leaf, and ordered reads then write to the leaves they visit.
+#define FINGERPRINT_LEAVES 0
@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification:   include/scan_filter.h
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <climits>
+#include <vector>
+#include "b_plus_tree.h"
+#include "para.h"
+
+/*
+ * Predicates pushed down into BPlusTree::FilteredScan.
+ *
+ * A row is kept when every predicate that is set holds. The defaults keep
+ * every row, so a caller only fills in the fields it filters on.
+ */
+struct ScanFilter {
+    // keep keys with (key & key_mask) == key_bits, a zero mask keeps all
+    unsigned int key_mask = 0;
+    unsigned int key_bits = 0;
+    // keep keys with key % key_modulo == key_residue, 0 keeps all.
+    // The residue follows C++ rules, so it is negative for negative keys
+    int key_modulo = 0;
+    int key_residue = 0;
+    // keep page ids within [page_min, page_max]
+    int page_min = INT_MIN;
+    int page_max = INT_MAX;
+    // keep page ids listed here, empty keeps all
+    std::vector<int> page_ids;
+    // keep about this fraction of the rows, chosen by a hash of the key so
+    // the same keys are sampled on every scan with the same seed
+    double sample_rate = 1.0;
+    unsigned int sample_seed = 0;
+};
+
+/*
+ * Caller-provided column buffers for FilteredScan.
+ *
+ * The projection is given by the columns that are set: keys only, pointers
+ * only or both. Each column must hold at least capacity entries.
+ */
+struct ScanColumns {
+    KeyType *keys = NULL;
+    RecordPointer *pointers = NULL;
+    int capacity = 0;
+    // rows written by the last scan
+    int rows = 0;
+    // true when the columns filled up before the end of the range, the scan
+    // can be resumed from next_key
+    bool truncated = false;
+    KeyType next_key;
+};
+
+// Rows evaluated together, one bit per row in the selection mask
+#define SCAN_BATCH 64
+
+// Page id sets up to this size are compared with SIMD, larger ones are
+// binary searched
+#define SCAN_SIMD_SET_MAX 8
+
+/*
+ * A ScanFilter prepared for evaluation: the page id set is sorted and
+ * power-of-two moduli become bit masks, so most predicates run with SIMD.
+ */
+class ScanFilterEvaluator {
+public:
+    explicit ScanFilterEvaluator(const ScanFilter &filter);
+
+    // Returns the selection mask of up to SCAN_BATCH rows, bit i set when
+    // row i passes every predicate. Both arrays are read in groups of 4, so
+    // they must have room for row_num rounded up to a multiple of 4
+    unsigned long long Evaluate(const KeyType *keys, const RecordPointer *pointers, int row_num) const;
+
+private:
+    ScanFilter filter;
+    std::vector<int> page_set;
+    // modulo predicate evaluated as a mask, 0 when key_modulo is not a power of two
+    unsigned int modulo_mask = 0;
+    // sampled rows have a key hash below this
+    unsigned int sample_threshold = 0;
+    bool sample_all = true;
+
+    // Scalar versions of the predicates for builds without SIMD
+    bool KeepKey(const KeyType &key) const;
+    bool KeepPointer(const RecordPointer &pointer) const;
+};
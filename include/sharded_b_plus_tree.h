@@ -0,0 +1,117 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification:   include/sharded_b_plus_tree.h
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "b_plus_tree.h"
+#include "para.h"
+
+/**
+ * Range-partitioned front end over several independent B+ trees.
+ *
+ * The key space is cut into contiguous ranges, one per shard. Every shard is
+ * its own BPlusTree protected by its own latch, with its nodes allocated on
+ * the NUMA node the shard is assigned to, so threads working on different
+ * ranges never touch the same root or the same remote memory.
+ * (1) Insert / GetValue / Remove go to exactly one shard
+ * (2) RangeScan walks the shards in key order
+ * (3) Rebalance moves partition boundaries online when shards get skewed
+ */
+class ShardedBPlusTree {
+public:
+    // Split [key_min, key_max) evenly into shard_num partitions. Keys outside
+    // of that range go to the first or last shard.
+    ShardedBPlusTree(int shard_num, const KeyType &key_min, const KeyType &key_max,
+                     bool numa_aware = true);
+    ~ShardedBPlusTree();
+
+    ShardedBPlusTree(const ShardedBPlusTree &) = delete;
+    ShardedBPlusTree &operator=(const ShardedBPlusTree &) = delete;
+
+    // Returns true if no shard has keys
+    bool IsEmpty();
+
+    // Insert a key-value pair, false if the key already exists
+    bool Insert(const KeyType &key, const RecordPointer &value);
+
+    // Remove a key and its value
+    void Remove(const KeyType &key);
+
+    // return the value associated with a given key
+    bool GetValue(const KeyType &key, RecordPointer &result);
+
+    // return the values within a key range [key_start, key_end), in key order
+    void RangeScan(const KeyType &key_start, const KeyType &key_end,
+                   std::vector<RecordPointer> &result);
+
+    // Even out neighbouring shards whose sizes differ by more than
+    // skew_ratio. Safe to call while other threads use the tree.
+    // @return: number of partition boundaries that were moved
+    int Rebalance(double skew_ratio = 2.0);
+
+    int ShardNum() const { return (int) shards.size(); }
+
+    // Index of the shard currently owning the key
+    int ShardOf(const KeyType &key);
+
+    // NUMA node the shard's nodes live on, -1 if NUMA placement is off
+    int NumaNodeOf(int shard) const { return shards[shard]->numa_node; }
+
+    // Number of keys stored in the shard
+    size_t ShardSize(int shard);
+
+    // log every operation on the front end to the recorder, NULL to stop
+    void SetRecorder(TraceRecorder *recorder) { this->recorder = recorder; }
+
+    // put one point lookup cache in front of all shards, NULL to stop.
+    // The cache is not owned by the tree. Not safe while Rebalance runs.
+    void SetCache(HotKeyCache *cache);
+
+    // Shape of all shards together, height is the tallest shard's
+    void GetStats(TreeStats &stats);
+
+private:
+    struct Shard {
+        std::mutex latch;
+        BPlusTree *tree;
+        int numa_node;
+        // shard owns [lower, next shard's lower), guarded by the latch
+        KeyType lower;
+        size_t key_num = 0;
+    };
+
+    std::vector<Shard*> shards;
+
+    // One node arena per NUMA node, empty if NUMA placement is off
+    std::vector<std::shared_ptr<NumaArena>> arenas;
+
+    // Lower bound of every shard, read without latches to route requests.
+    // Routing is re-checked under the shard latch since it may be stale.
+    std::atomic<KeyType> *lower_bounds;
+
+    // Optional workload recorder, not owned
+    TraceRecorder *recorder = NULL;
+
+    // Optional point lookup cache shared by the shards, not owned
+    HotKeyCache *cache = NULL;
+
+    // Lock and return the shard owning the key
+    int LockShardFor(const KeyType &key);
+
+    // Returns true if the key belongs to the shard, caller holds its latch
+    bool Owns(int shard, const KeyType &key) const;
+
+    // Move keys between shard and shard+1 so both hold about the same number
+    bool RebalancePair(int shard, double skew_ratio);
+};
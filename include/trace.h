@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification:   include/trace.h
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "para.h"
+
+/*
+ * Binary workload traces.
+ *
+ * A trace starts with the 8 byte magic "BPTRACE1" followed by one record per
+ * operation:
+ *   op (1 byte) | time delta in ns (varint) | key (zigzag varint) | args
+ * where args are page_id and record_id for Insert, the scan width
+ * key_end - key for RangeScan and nothing for GetValue and Remove. Time
+ * deltas are relative to the previous record so pacing can be reproduced.
+ */
+
+enum TraceOpType {
+    TRACE_INSERT = 1,
+    TRACE_GET_VALUE = 2,
+    TRACE_RANGE_SCAN = 3,
+    TRACE_REMOVE = 4
+};
+
+// One traced operation
+struct TraceOp {
+    TraceOpType type;
+    // nanoseconds since the recorder was opened
+    long long timestamp;
+    KeyType key;
+    // RangeScan only
+    KeyType key_end;
+    // Insert only
+    int page_id;
+    int record_id;
+};
+
+// Appends operations to a trace file, safe to share between threads
+class TraceRecorder {
+public:
+    explicit TraceRecorder(const std::string &path);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    // Returns false if the trace file could not be opened
+    bool IsOpen() const { return file != NULL; }
+
+    void RecordInsert(const KeyType &key, int page_id, int record_id);
+    void RecordGetValue(const KeyType &key);
+    void RecordRangeScan(const KeyType &key_start, const KeyType &key_end);
+    void RecordRemove(const KeyType &key);
+
+    // Write buffered records to the file
+    void Flush();
+
+private:
+    std::mutex latch;
+    FILE *file;
+    std::vector<unsigned char> buffer;
+    std::chrono::steady_clock::time_point start;
+    long long last_timestamp = 0;
+
+    // Append the op byte and the time delta, caller holds the latch
+    void BeginRecord(TraceOpType type);
+    void PutVarint(unsigned long long value);
+    void PutSigned(long long value);
+};
+
+// Reads a trace file written by TraceRecorder
+class TraceReader {
+public:
+    explicit TraceReader(const std::string &path);
+    ~TraceReader();
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    // Returns false if the file is missing or not a trace
+    bool IsOpen() const { return file != NULL; }
+
+    // Read the next operation, false at the end of the trace
+    bool Next(TraceOp &op);
+
+    // Convenience: read every remaining operation
+    bool ReadAll(std::vector<TraceOp> &ops);
+
+private:
+    FILE *file;
+    long long timestamp = 0;
+    bool corrupt = false;
+
+    bool GetVarint(unsigned long long &value);
+    bool GetSigned(long long &value);
+};
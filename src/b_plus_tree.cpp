@@ -1,6 +1,85 @@
 #include "include/b_plus_tree.h"
+#include "include/hot_key_cache.h"
+#include "include/scan_filter.h"
+#include <cmath>
 #include <iostream>
+#include <new>
 #include <queue>
+#if FINGERPRINT_LEAVES && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Minimum number of keys in a non-root node, the bound verifyTreeProperty checks
+static const int MIN_KEY_NUM = (MAX_FANOUT-1)/2;
+
+#if FINGERPRINT_LEAVES
+// 1-byte hash of a key, the top bits of a multiplicative hash
+static inline unsigned char Fingerprint(const KeyType &key) {
+    return (unsigned char) (((unsigned int) key * 2654435761u) >> 24);
+}
+#endif
+
+BPlusTree::BPlusTree(int numa_node) {
+    arena = std::make_shared<NumaArena>(numa_node);
+}
+
+BPlusTree::BPlusTree(const std::shared_ptr<NumaArena> &arena) : arena(arena) {}
+
+BPlusTree::~BPlusTree() {
+    FreeSubtree(root);
+    root = NULL;
+}
+
+/*****************************************************************************
+ * NODE ALLOCATION
+ *****************************************************************************/
+LeafNode* BPlusTree::NewLeafNode() {
+    if (arena == NULL) {
+        return new LeafNode();
+    }
+    return new (arena->Allocate(sizeof(LeafNode))) LeafNode();
+}
+
+InternalNode* BPlusTree::NewInternalNode() {
+    if (arena == NULL) {
+        return new InternalNode();
+    }
+    return new (arena->Allocate(sizeof(InternalNode))) InternalNode();
+}
+
+void BPlusTree::FreeNode(Node *node) {
+    freed_nodes++;
+    freed_bytes += node->is_leaf ? sizeof(LeafNode) : sizeof(InternalNode);
+    // Nodes have trivial destructors, so the arena only needs the memory back
+    if (node->is_leaf) {
+        if (arena == NULL) {
+            delete (LeafNode*) node;
+        } else {
+            arena->Free(node, sizeof(LeafNode));
+        }
+    } else {
+        if (arena == NULL) {
+            delete (InternalNode*) node;
+        } else {
+            arena->Free(node, sizeof(InternalNode));
+        }
+    }
+}
+
+// Release the node and everything below it
+void BPlusTree::FreeSubtree(Node *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (!node->is_leaf) {
+        InternalNode *internal_node = (InternalNode*) node;
+        for (int i=0; i<internal_node->key_num+1; i++) {
+            FreeSubtree(internal_node->children[i]);
+        }
+    }
+    FreeNode(node);
+}
+
 /*
  * Helper function to decide whether current b+tree is empty
  */
@@ -21,6 +100,13 @@ bool BPlusTree::IsEmpty() const {
  * @return : true means key exists
  */
 bool BPlusTree::GetValue(const KeyType &key, RecordPointer &result) {
+    if (recorder != NULL) {
+        recorder->RecordGetValue(key);
+    }
+    // Frequent keys skip the descent
+    if (cache != NULL && cache->Lookup(key, result)) {
+        return true;
+    }
     // Check if tree is empty
     if (IsEmpty()) {
         return false;
@@ -28,17 +114,60 @@ bool BPlusTree::GetValue(const KeyType &key, RecordPointer &result) {
     
     // Get the appropriate node for the specified key
     LeafNode *leaf_node = (LeafNode*) getChildForKey(key);
-    // Iterate the leaf node to find the pointer to the required key
-    for (int i=0; i<leaf_node->key_num; i++) {
-        if (leaf_node->keys[i] == key) {
-            // When key is found store the page id in the result and return true
-            result.page_id = leaf_node->pointers[i].page_id;
-            result.record_id = leaf_node->pointers[i].record_id;
-            return true;
+    // Find the pointer to the required key in the leaf node
+    int i = FindInLeaf(leaf_node, key);
+    if (i < 0) {
+        // Return false if not found
+        return false;
+    }
+    // When key is found store the page id in the result and return true
+    result.page_id = leaf_node->pointers[i].page_id;
+    result.record_id = leaf_node->pointers[i].record_id;
+    if (cache != NULL) {
+        cache->Admit(key, result);
+    }
+    return true;
+}
+
+/*
+ * Return the position of the key in the leaf, or -1 if it is not there.
+ * With FINGERPRINT_LEAVES the 1-byte hashes are compared 16 at a time and
+ * only the keys whose hash matches are looked at.
+ */
+int BPlusTree::FindInLeaf(LeafNode *leaf, const KeyType &key) {
+#if FINGERPRINT_LEAVES
+    unsigned char fingerprint = Fingerprint(key);
+#ifdef __SSE2__
+    __m128i needle = _mm_set1_epi8((char) fingerprint);
+    for (int base=0; base<leaf->key_num; base+=16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (leaf->fingerprints + base));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        // Ignore the slots past the last entry
+        if (leaf->key_num - base < 16) {
+            mask &= (1u << (leaf->key_num - base)) - 1;
+        }
+        for (; mask != 0; mask &= mask-1) {
+            int i = base + __builtin_ctz(mask);
+            if (leaf->keys[i] == key) {
+                return i;
+            }
         }
     }
-    // Return false if not found
-    return false;
+#else
+    for (int i=0; i<leaf->key_num; i++) {
+        if (leaf->fingerprints[i] == fingerprint && leaf->keys[i] == key) {
+            return i;
+        }
+    }
+#endif
+#else
+    for (int i=0; i<leaf->key_num && leaf->keys[i]<=key; i++) {
+        if (leaf->keys[i] == key) {
+            return i;
+        }
+    }
+#endif
+    return -1;
 }
 
 // Helper function to get the appropriate node for the search key
@@ -75,28 +204,47 @@ Node* BPlusTree::getChildForKey(const KeyType &key) {
  * keys return false, otherwise return true.
  */
 bool BPlusTree::Insert(const KeyType &key, const RecordPointer &value) {
-    key_value_pairs.push_back(make_pair(key, value));
+    if (recorder != NULL) {
+        recorder->RecordInsert(key, value.page_id, value.record_id);
+    }
+    // Drop any cached value of the key so the cache never disagrees with the tree
+    if (cache != NULL) {
+        cache->Invalidate(key);
+    }
     // If the tree is empty then create a new root
     if (IsEmpty()) {
-        LeafNode *new_node      = new LeafNode();
+        LeafNode *new_node      = NewLeafNode();
         new_node->keys[0]       = key;
         new_node->key_num       = 1;
         new_node->pointers[0]   = value;
         new_node->is_leaf       = true;
+        RefreshFingerprints(new_node);
         
         root = new_node;
         return true;
     }
 
-    // Get the appropriate leaf node for the key
-    LeafNode *curr_node = (LeafNode*) getChildForKey(key);
+    // Get the appropriate leaf node for the key, remembering the path to it
+    NodePath path;
+    LeafNode *curr_node = FindLeaf(key, path);
+
+    // Keys are unique, reject duplicates
+    if (FindInLeaf(curr_node, key) >= 0) {
+        return false;
+    }
+#if ORDER_STATISTICS
+    // The new key ends up below every node on the path, even after splits
+    UpdatePathCounts(path, 1);
+#endif
     
     if (curr_node->key_num < MAX_FANOUT-1) {
         // If Node is not full insert in the leaf
         return InsertInLeaf((LeafNode*)curr_node, key, value);
     } else {
-        LeafNode *new_node = new LeafNode();
+        LeafNode *new_node = NewLeafNode();
         new_node->is_leaf = true;
+        // Splitting needs the entries in key order
+        SortLeaf(curr_node);
         KeyType temp_keys[MAX_FANOUT];
         RecordPointer temp_records[MAX_FANOUT];
 
@@ -133,6 +281,8 @@ bool BPlusTree::Insert(const KeyType &key, const RecordPointer &value) {
             new_node->pointers[i]  = temp_records[j];
             new_node->key_num++;
         }
+        RefreshFingerprints(curr_node);
+        RefreshFingerprints(new_node);
 
         // Connect the leaf node linked list
         if (curr_node->next_leaf) {
@@ -144,22 +294,37 @@ bool BPlusTree::Insert(const KeyType &key, const RecordPointer &value) {
 
         // If the current node is root then create a new root node
         if (curr_node == root) {
-            InternalNode* new_root_node = new InternalNode();
+            InternalNode* new_root_node = NewInternalNode();
             new_root_node->keys[0] = new_node->keys[0];
             new_root_node->key_num = 1;
             new_root_node->children[0] = curr_node;
             new_root_node->children[1] = new_node;
             new_root_node->is_leaf = false;
+#if ORDER_STATISTICS
+            RecountNode(new_root_node);
+#endif
             root = new_root_node;
         } else {
-            // Else insert into the parent
-            InsertInParent(new_node->keys[0], FindParent((InternalNode*)root, (InternalNode*)curr_node), new_node);
+            // Else insert into the parent, right after the current node
+            InsertInParent(new_node->keys[0], path, path.size()-1, new_node, path.back().second+1);
         }
     }
     return true;
 }
 
 bool BPlusTree::InsertInLeaf (LeafNode *leaf, const KeyType &key, const RecordPointer &value) {
+#if FINGERPRINT_LEAVES
+    // Append without moving anything, the leaf stays sorted only if the key
+    // is the largest one
+    if (leaf->key_num > 0 && key < leaf->keys[leaf->key_num-1]) {
+        leaf->is_sorted = false;
+    }
+    leaf->keys[leaf->key_num]           = key;
+    leaf->pointers[leaf->key_num]       = value;
+    leaf->fingerprints[leaf->key_num]   = Fingerprint(key);
+    leaf->key_num++;
+    return true;
+#else
     int i;
     // Find position for the new key
     for (i=0; i<leaf->key_num && key>leaf->keys[i]; i++);
@@ -176,26 +341,70 @@ bool BPlusTree::InsertInLeaf (LeafNode *leaf, const KeyType &key, const RecordPo
     leaf->key_num++;
 
     return true;
+#endif
+}
+
+// Put the entries of the leaf back in key order
+void BPlusTree::SortLeaf(LeafNode *leaf) {
+#if FINGERPRINT_LEAVES
+    if (leaf->is_sorted) {
+        return;
+    }
+    // Leaves are small, insertion sort moves the fewest entries
+    for (int i=1; i<leaf->key_num; i++) {
+        KeyType key = leaf->keys[i];
+        RecordPointer value = leaf->pointers[i];
+        unsigned char fingerprint = leaf->fingerprints[i];
+        int j;
+        for (j=i; j>0 && leaf->keys[j-1]>key; j--) {
+            leaf->keys[j]           = leaf->keys[j-1];
+            leaf->pointers[j]       = leaf->pointers[j-1];
+            leaf->fingerprints[j]   = leaf->fingerprints[j-1];
+        }
+        leaf->keys[j]           = key;
+        leaf->pointers[j]       = value;
+        leaf->fingerprints[j]   = fingerprint;
+    }
+    leaf->is_sorted = true;
+#endif
+}
+
+// Recompute the hashes after the keys of a sorted leaf were rewritten
+void BPlusTree::RefreshFingerprints(LeafNode *leaf) {
+#if FINGERPRINT_LEAVES
+    for (int i=0; i<leaf->key_num; i++) {
+        leaf->fingerprints[i] = Fingerprint(leaf->keys[i]);
+    }
+    leaf->is_sorted = true;
+#endif
 }
 
-bool BPlusTree::InsertInParent (const KeyType &key, InternalNode* parent_node, Node* new_node) {
+/*
+ * Insert new_node as child child_pos of the node at path[level]. The key
+ * separates new_node from its left neighbour, or from the old first child
+ * when new_node becomes the first child. A full node is split and the middle
+ * key is pushed up to the next node on the path.
+ */
+bool BPlusTree::InsertInParent(const KeyType &key, NodePath &path, int level, Node *new_node, int child_pos) {
+    InternalNode *parent_node = path[level].first;
+    int key_pos = child_pos > 0 ? child_pos-1 : 0;
     
     // If parent node is not full, then insert the new key in the same node
     if (parent_node->key_num < MAX_FANOUT-1) {
-        int i;
-        for (i=0; i<parent_node->key_num && key>parent_node->keys[i]; i++);
-
-        for (int j=parent_node->key_num; j>i; j--) {
+        for (int j=parent_node->key_num; j>key_pos; j--) {
             parent_node->keys[j] = parent_node->keys[j-1];
         }
 
-        for (int j=parent_node->key_num+1; j>i+1; j--) {
+        for (int j=parent_node->key_num+1; j>child_pos; j--) {
             parent_node->children[j] = parent_node->children[j-1];
         }
 
-        parent_node->keys[i]       = key;
-        parent_node->children[i+1] = new_node;
+        parent_node->keys[key_pos]          = key;
+        parent_node->children[child_pos]    = new_node;
         parent_node->key_num++;
+#if ORDER_STATISTICS
+        RecountNode(parent_node);
+#endif
         return true;
     }
 
@@ -211,25 +420,23 @@ bool BPlusTree::InsertInParent (const KeyType &key, InternalNode* parent_node, N
         temp_children[i]    = parent_node->children[i];
     }
 
-    // Find position for the new key
-    for (i=0; i<MAX_FANOUT-1 && key>temp_keys[i]; i++);
-
     // Move the keys and children to make space for the new key and new child
-    for (int j=parent_node->key_num; j>i; j--) {
+    for (int j=parent_node->key_num; j>key_pos; j--) {
         temp_keys[j] = temp_keys[j-1];
     }
-    for (int j=parent_node->key_num+1; j>i+1; j--) {
+    for (int j=parent_node->key_num+1; j>child_pos; j--) {
         temp_children[j] = temp_children[j-1];
     }
 
     // Insert the new key and child at their position
-    temp_keys[i]        = key;
-    temp_children[i+1]  = new_node;
+    temp_keys[key_pos]          = key;
+    temp_children[child_pos]    = new_node;
 
     // Split the parent node to maintain MAX_FANOUT condition
-    InternalNode *new_parent_node = new InternalNode();
+    InternalNode *new_parent_node = NewInternalNode();
     new_parent_node->is_leaf = false;
-    int split = ceil(MAX_FANOUT/2.0);
+    // The middle key moves up, leaving both halves at least half full
+    int split = MAX_FANOUT/2;
     parent_node->key_num = 0;
     new_parent_node->key_num = 0;
     
@@ -247,47 +454,45 @@ bool BPlusTree::InsertInParent (const KeyType &key, InternalNode* parent_node, N
         new_parent_node->key_num++;
     }
     new_parent_node->children[i] = temp_children[j];
+#if ORDER_STATISTICS
+    RecountNode(parent_node);
+    RecountNode(new_parent_node);
+#endif
     
     // If parent node is root node then create a new root node
-    if (parent_node == root) {
-        InternalNode* new_root_node = new InternalNode();
+    if (level == 0) {
+        InternalNode* new_root_node = NewInternalNode();
         new_root_node->keys[0] = temp_keys[split];
         new_root_node->key_num = 1;
         new_root_node->children[0] = parent_node;
         new_root_node->children[1] = new_parent_node;
         new_root_node->is_leaf = false;
+#if ORDER_STATISTICS
+        RecountNode(new_root_node);
+#endif
 
         root = new_root_node;
     } else {
         // Else recurse and insert into it's parent
-        InsertInParent(temp_keys[split], FindParent((InternalNode*)root, parent_node), new_parent_node);
+        InsertInParent(temp_keys[split], path, level-1, new_parent_node, path[level-1].second+1);
     }
 
     return true;
 }
 
-// Function to find parent of the given node
-InternalNode* BPlusTree::FindParent(InternalNode* root_node, InternalNode* search_node) {
-    InternalNode *parent_node;
-
-    // If root node is leaf then it has no parent
-    if (root_node->is_leaf) {
-        return NULL;
-    }
-
-    // Iterate the node's children to look for the search node using DFS method
-    for (int i=0; i<root_node->key_num+1; i++) {
-        if (root_node->children[i] == search_node) {
-            parent_node = root_node;
-            return parent_node;
-        } else {
-            parent_node = FindParent((InternalNode*)root_node->children[i], search_node);
-            if (parent_node != NULL) {
-                return parent_node;
-            }
-        }
+// Function to find the leaf for the key, recording every internal node on the
+// way together with the index of the child we took
+LeafNode* BPlusTree::FindLeaf(const KeyType &key, NodePath &path) {
+    Node *curr_node = root;
+    while (!curr_node->is_leaf) {
+        InternalNode *parent_node = (InternalNode*) curr_node;
+        int i;
+        // Same routing as getChildForKey
+        for (i=0; i<parent_node->key_num && key>=parent_node->keys[i]; i++);
+        path.push_back(make_pair(parent_node, i));
+        curr_node = parent_node->children[i];
     }
-    return parent_node;
+    return (LeafNode*) curr_node;
 }
 
 /*****************************************************************************
@@ -300,34 +505,706 @@ InternalNode* BPlusTree::FindParent(InternalNode* root_node, InternalNode* searc
  * delete entry from leaf node. Remember to deal with redistribute or merge if
  * necessary.
  */
-void BPlusTree::Remove(const KeyType &key) {
-    // Used an unorthodox method which maintains list of key value pairs, removes the needed key-value pair and creates a new tree.
-    LeafNode* new_root = new LeafNode();
-    int i=0;
+bool BPlusTree::Remove(const KeyType &key) {
+    if (recorder != NULL) {
+        recorder->RecordRemove(key);
+    }
+    if (cache != NULL) {
+        cache->Invalidate(key);
+    }
+    if (IsEmpty()) {
+        return false;
+    }
+
+    // Find the leaf holding the key and the position of the key in it
+    NodePath path;
+    LeafNode *leaf_node = FindLeaf(key, path);
+    int i = FindInLeaf(leaf_node, key);
+    if (i < 0) {
+        return false;
+    }
+
+#if FINGERPRINT_LEAVES
+    // Leaves may be unordered, so move the last entry into the gap
+    int last = leaf_node->key_num-1;
+    if (i != last) {
+        leaf_node->keys[i]          = leaf_node->keys[last];
+        leaf_node->pointers[i]      = leaf_node->pointers[last];
+        leaf_node->fingerprints[i]  = leaf_node->fingerprints[last];
+        leaf_node->is_sorted = false;
+    }
+#else
+    // Close the gap left by the key
+    for (; i<leaf_node->key_num-1; i++) {
+        leaf_node->keys[i]      = leaf_node->keys[i+1];
+        leaf_node->pointers[i]  = leaf_node->pointers[i+1];
+    }
+#endif
+    leaf_node->key_num--;
+#if ORDER_STATISTICS
+    UpdatePathCounts(path, -1);
+#endif
+
+    // The root may hold any number of keys, it only goes away once empty
+    if (leaf_node == root) {
+        if (leaf_node->key_num == 0) {
+            FreeNode(leaf_node);
+            root = NULL;
+        }
+        return true;
+    }
+    RebalancePath(path, leaf_node);
+    return true;
+}
 
-    for (i=0; i<key_value_pairs.size(); i++) {
-        if (key_value_pairs[i].first == key) {
+// Walk up the path fixing under-filled nodes, merges may cascade upwards
+void BPlusTree::RebalancePath(NodePath &path, Node *node) {
+    for (int level=path.size()-1; level>=0 && node->key_num<MIN_KEY_NUM; level--) {
+        if (!FixUnderflow(path[level].first, path[level].second)) {
             break;
         }
+        node = path[level].first;
     }
-    // Remove the pair that needs to be deleted
-    std::vector<pair<KeyType,RecordPointer>>::iterator it = key_value_pairs.begin();
-    std::advance(it, i);
-    key_value_pairs.erase(it);
+    ShrinkRoot();
+}
 
-    // Create a new tree after removing the key
-    new_root->keys[0] = key_value_pairs[0].first;
-    new_root->key_num = 1;
-    new_root->pointers[0] = key_value_pairs[0].second;
-    new_root->is_leaf = true;
-    root = new_root;
+/*
+ * Fix the under-filled child at index idx with its left sibling, or its right
+ * sibling if it is the first child. The two are merged if they fit in one
+ * node, otherwise their entries are split evenly between them.
+ * @return: true if they were merged and the parent lost a key
+ */
+bool BPlusTree::FixUnderflow(InternalNode *parent_node, int idx) {
+    int left = idx > 0 ? idx-1 : 0;
+    Node *left_node = parent_node->children[left];
+    Node *right_node = parent_node->children[left+1];
 
-    for (i=1; i<key_value_pairs.size(); i++) {
-        Insert(key_value_pairs[i].first, key_value_pairs[i].second);
-        key_value_pairs.pop_back();
+    if (!CanMerge(left_node, right_node)) {
+        RedistributeNodes(left_node, parent_node->keys[left], right_node);
+#if ORDER_STATISTICS
+        RecountNode(parent_node);
+#endif
+        return false;
+    }
+
+    MergeNodes(left_node, parent_node->keys[left], right_node);
+    // Drop the separator and the merged child from the parent
+    for (int i=left; i<parent_node->key_num-1; i++) {
+        parent_node->keys[i] = parent_node->keys[i+1];
+    }
+    for (int i=left+1; i<parent_node->key_num; i++) {
+        parent_node->children[i] = parent_node->children[i+1];
+    }
+    parent_node->key_num--;
+#if ORDER_STATISTICS
+    RecountNode(parent_node);
+#endif
+    return true;
+}
+
+// Returns true if the two neighbouring nodes fit into a single node
+bool BPlusTree::CanMerge(Node *left_node, Node *right_node) {
+    if (left_node->is_leaf) {
+        return left_node->key_num + right_node->key_num <= MAX_FANOUT-1;
+    }
+    // The separator moves down into the merged internal node
+    return left_node->key_num + right_node->key_num + 1 <= MAX_FANOUT-1;
+}
+
+// Move everything of right_node into left_node and release right_node
+void BPlusTree::MergeNodes(Node *left_node, const KeyType &separator, Node *right_node) {
+    if (left_node->is_leaf) {
+        LeafNode *left_leaf = (LeafNode*) left_node;
+        LeafNode *right_leaf = (LeafNode*) right_node;
+        for (int i=0; i<right_leaf->key_num; i++) {
+            left_leaf->keys[left_leaf->key_num]     = right_leaf->keys[i];
+            left_leaf->pointers[left_leaf->key_num] = right_leaf->pointers[i];
+#if FINGERPRINT_LEAVES
+            left_leaf->fingerprints[left_leaf->key_num] = right_leaf->fingerprints[i];
+#endif
+            left_leaf->key_num++;
+        }
+#if FINGERPRINT_LEAVES
+        // Every right key is larger, so order survives if both were sorted
+        left_leaf->is_sorted = left_leaf->is_sorted && right_leaf->is_sorted;
+#endif
+        // Unlink the right leaf from the leaf node linked list
+        left_leaf->next_leaf = right_leaf->next_leaf;
+        if (right_leaf->next_leaf) {
+            right_leaf->next_leaf->prev_leaf = left_leaf;
+        }
+    } else {
+        InternalNode *left_internal = (InternalNode*) left_node;
+        InternalNode *right_internal = (InternalNode*) right_node;
+        left_internal->keys[left_internal->key_num] = separator;
+        for (int i=0; i<right_internal->key_num; i++) {
+            left_internal->keys[left_internal->key_num+1+i] = right_internal->keys[i];
+        }
+        for (int i=0; i<right_internal->key_num+1; i++) {
+            left_internal->children[left_internal->key_num+1+i] = right_internal->children[i];
+        }
+        left_internal->key_num += right_internal->key_num + 1;
+#if ORDER_STATISTICS
+        RecountNode(left_internal);
+#endif
+    }
+    FreeNode(right_node);
+}
+
+// Split the entries of two neighbouring nodes evenly, updating the separator
+void BPlusTree::RedistributeNodes(Node *left_node, KeyType &separator, Node *right_node) {
+    if (left_node->is_leaf) {
+        LeafNode *left_leaf = (LeafNode*) left_node;
+        LeafNode *right_leaf = (LeafNode*) right_node;
+        KeyType temp_keys[2*MAX_FANOUT];
+        RecordPointer temp_records[2*MAX_FANOUT];
+        SortLeaf(left_leaf);
+        SortLeaf(right_leaf);
+
+        int total = 0;
+        for (int i=0; i<left_leaf->key_num; i++, total++) {
+            temp_keys[total]    = left_leaf->keys[i];
+            temp_records[total] = left_leaf->pointers[i];
+        }
+        for (int i=0; i<right_leaf->key_num; i++, total++) {
+            temp_keys[total]    = right_leaf->keys[i];
+            temp_records[total] = right_leaf->pointers[i];
+        }
+
+        int split = total/2;
+        left_leaf->key_num = 0;
+        right_leaf->key_num = 0;
+        for (int i=0; i<total; i++) {
+            LeafNode *leaf = i < split ? left_leaf : right_leaf;
+            leaf->keys[leaf->key_num]       = temp_keys[i];
+            leaf->pointers[leaf->key_num]   = temp_records[i];
+            leaf->key_num++;
+        }
+        RefreshFingerprints(left_leaf);
+        RefreshFingerprints(right_leaf);
+        separator = right_leaf->keys[0];
+        return;
+    }
+
+    InternalNode *left_internal = (InternalNode*) left_node;
+    InternalNode *right_internal = (InternalNode*) right_node;
+    KeyType temp_keys[2*MAX_FANOUT];
+    Node *temp_children[2*MAX_FANOUT];
+
+    // The separator sits between the keys of the two nodes
+    int key_total = 0, child_total = 0;
+    for (int i=0; i<left_internal->key_num; i++) {
+        temp_keys[key_total++] = left_internal->keys[i];
+    }
+    temp_keys[key_total++] = separator;
+    for (int i=0; i<right_internal->key_num; i++) {
+        temp_keys[key_total++] = right_internal->keys[i];
+    }
+    for (int i=0; i<left_internal->key_num+1; i++) {
+        temp_children[child_total++] = left_internal->children[i];
+    }
+    for (int i=0; i<right_internal->key_num+1; i++) {
+        temp_children[child_total++] = right_internal->children[i];
+    }
+
+    // Left keeps the first half of the children, the key in between moves up
+    int split = child_total/2;
+    left_internal->key_num = split-1;
+    for (int i=0; i<split; i++) {
+        left_internal->children[i] = temp_children[i];
+        if (i < split-1) {
+            left_internal->keys[i] = temp_keys[i];
+        }
+    }
+    separator = temp_keys[split-1];
+    right_internal->key_num = child_total-split-1;
+    for (int i=split; i<child_total; i++) {
+        right_internal->children[i-split] = temp_children[i];
+        if (i < child_total-1) {
+            right_internal->keys[i-split] = temp_keys[i];
+        }
+    }
+#if ORDER_STATISTICS
+    RecountNode(left_internal);
+    RecountNode(right_internal);
+#endif
+}
+
+// Drop internal roots that are left with a single child
+void BPlusTree::ShrinkRoot() {
+    while (root != NULL && !root->is_leaf && root->key_num == 0) {
+        Node *old_root = root;
+        root = ((InternalNode*) root)->children[0];
+        FreeNode(old_root);
     }
 }
 
+/*****************************************************************************
+ * SPLIT & CONCATENATE
+ *****************************************************************************/
+/*
+ * Move every key >= key into the empty tree other.
+ * We cut each node along the root-to-leaf path of the key into the children
+ * left and right of the path, then glue the pieces of each side back together
+ * bottom-up. Each join only walks the height difference of its two pieces,
+ * so the whole split costs O(height). Both trees share the node allocator
+ * afterwards.
+ * @return: false if other is not empty
+ */
+bool BPlusTree::SplitAt(const KeyType &key, BPlusTree &other) {
+    if (&other == this || !other.IsEmpty()) {
+        return false;
+    }
+    other.arena = arena;
+    if (IsEmpty()) {
+        return true;
+    }
+    // Keys moving to a tree behind another cache must not be served from ours
+    if (cache != NULL && other.cache != cache) {
+        cache->Clear();
+    }
+
+    // Pieces cut off at every level from the root down, with their heights
+    // and the separator between them and the rest of their side
+    std::vector<std::pair<Node*, int>> left_pieces, right_pieces;
+    std::vector<KeyType> left_separators, right_separators;
+    int height = Height(root);
+    Node *curr_node = root;
+    root = NULL;
+
+    while (!curr_node->is_leaf) {
+        InternalNode *parent_node = (InternalNode*) curr_node;
+        int key_num = parent_node->key_num;
+        int i;
+        for (i=0; i<key_num && key>=parent_node->keys[i]; i++);
+        Node *next_node = parent_node->children[i];
+        height--;
+
+        // Children right of the path, as a new node unless there is only one
+        std::pair<Node*, int> right_piece(NULL, 0);
+        if (key_num-i == 1) {
+            right_piece = make_pair(parent_node->children[key_num], height);
+        } else if (key_num-i > 1) {
+            InternalNode *new_node = NewInternalNode();
+            for (int j=i+1; j<key_num; j++) {
+                new_node->keys[j-i-1] = parent_node->keys[j];
+            }
+            for (int j=i+1; j<key_num+1; j++) {
+                new_node->children[j-i-1] = parent_node->children[j];
+            }
+            new_node->key_num = key_num-i-1;
+#if ORDER_STATISTICS
+            RecountNode(new_node);
+#endif
+            right_piece = make_pair(new_node, height+1);
+        }
+        right_pieces.push_back(right_piece);
+        right_separators.push_back(i < key_num ? parent_node->keys[i] : key);
+
+        // Children left of the path reuse the node unless there is only one
+        std::pair<Node*, int> left_piece(NULL, 0);
+        left_separators.push_back(i > 0 ? parent_node->keys[i-1] : key);
+        if (i == 1) {
+            left_piece = make_pair(parent_node->children[0], height);
+            FreeNode(parent_node);
+        } else if (i > 1) {
+            parent_node->key_num = i-1;
+            left_piece = make_pair(parent_node, height+1);
+        } else {
+            FreeNode(parent_node);
+        }
+        left_pieces.push_back(left_piece);
+
+        curr_node = next_node;
+    }
+
+    // Split the leaf itself and cut the leaf chain between the two halves
+    LeafNode *leaf_node = (LeafNode*) curr_node;
+    SortLeaf(leaf_node);
+    int i;
+    for (i=0; i<leaf_node->key_num && leaf_node->keys[i]<key; i++);
+    LeafNode *right_leaf = NULL;
+    if (i < leaf_node->key_num) {
+        right_leaf = NewLeafNode();
+        for (int j=i; j<leaf_node->key_num; j++) {
+            right_leaf->keys[j-i]       = leaf_node->keys[j];
+            right_leaf->pointers[j-i]   = leaf_node->pointers[j];
+        }
+        right_leaf->key_num = leaf_node->key_num-i;
+        RefreshFingerprints(right_leaf);
+        right_leaf->next_leaf = leaf_node->next_leaf;
+        if (right_leaf->next_leaf) {
+            right_leaf->next_leaf->prev_leaf = right_leaf;
+        }
+    } else if (leaf_node->next_leaf) {
+        leaf_node->next_leaf->prev_leaf = NULL;
+    }
+    leaf_node->key_num = i;
+    leaf_node->next_leaf = NULL;
+    LeafNode *left_leaf = leaf_node;
+    if (left_leaf->key_num == 0) {
+        if (left_leaf->prev_leaf) {
+            left_leaf->prev_leaf->next_leaf = NULL;
+        }
+        FreeNode(left_leaf);
+        left_leaf = NULL;
+    }
+
+    // Glue both sides back together from the bottom up
+    Node *left_tree = left_leaf, *right_tree = right_leaf;
+    int left_height = left_leaf ? 1 : 0, right_height = right_leaf ? 1 : 0;
+    for (int level=left_pieces.size()-1; level>=0; level--) {
+        left_height = Join(left_pieces[level].first, left_pieces[level].second,
+                           left_separators[level], left_tree, left_height);
+        left_tree = root;
+        right_height = Join(right_tree, right_height, right_separators[level],
+                            right_pieces[level].first, right_pieces[level].second);
+        right_tree = root;
+    }
+    root = left_tree;
+    other.root = right_tree;
+    return true;
+}
+
+/*
+ * Move every key of other into this tree. The key ranges of the two trees
+ * must not overlap; other may hold the smaller or the larger keys. Only the
+ * nodes along the seam are touched, unless the trees use different node
+ * allocators, in which case other's nodes are copied first.
+ * @return: false if the key ranges overlap
+ */
+bool BPlusTree::Concatenate(BPlusTree &other) {
+    if (&other == this) {
+        return false;
+    }
+    if (other.IsEmpty()) {
+        return true;
+    }
+    // The other tree ends up empty, so its cache must forget its keys
+    if (other.cache != NULL && other.cache != cache) {
+        other.cache->Clear();
+    }
+
+    // Nodes must come from this tree's allocator to be released by it
+    Node *other_root = other.root;
+    if (other.arena != arena) {
+        LeafNode *last_leaf = NULL;
+        other_root = CloneSubtree(other.root, last_leaf);
+        other.FreeSubtree(other.root);
+        other.root = other_root;
+    }
+
+    if (IsEmpty()) {
+        root = other_root;
+        other.root = NULL;
+        return true;
+    }
+
+    LeafNode *first_leaf = FirstLeaf(root), *last_leaf = LastLeaf(root);
+    LeafNode *other_first_leaf = FirstLeaf(other_root), *other_last_leaf = LastLeaf(other_root);
+    int height = Height(root), other_height = Height(other_root);
+    // The boundary keys of both trees are needed in order
+    SortLeaf(first_leaf);
+    SortLeaf(last_leaf);
+    SortLeaf(other_first_leaf);
+    SortLeaf(other_last_leaf);
+
+    if (last_leaf->keys[last_leaf->key_num-1] < other_first_leaf->keys[0]) {
+        // other goes to the right
+        last_leaf->next_leaf = other_first_leaf;
+        other_first_leaf->prev_leaf = last_leaf;
+        Join(root, height, other_first_leaf->keys[0], other_root, other_height);
+    } else if (other_last_leaf->keys[other_last_leaf->key_num-1] < first_leaf->keys[0]) {
+        // other goes to the left
+        other_last_leaf->next_leaf = first_leaf;
+        first_leaf->prev_leaf = other_last_leaf;
+        Join(other_root, other_height, first_leaf->keys[0], root, height);
+    } else {
+        return false;
+    }
+    other.root = NULL;
+    return true;
+}
+
+/*
+ * Join two trees given as (root, height), height 0 being the empty tree.
+ * Every key of left is smaller than separator and every key of right is at
+ * least separator. The shorter tree is hung off the spine of the taller one
+ * at the matching level, fixing only the nodes at the seam. Leaves of the
+ * two trees must already be linked.
+ * The joined tree becomes this tree's root.
+ * @return: the height of the joined tree
+ */
+int BPlusTree::Join(Node *left, int left_height, const KeyType &separator, Node *right, int right_height) {
+    if (right == NULL) {
+        root = left;
+        return left_height;
+    }
+    if (left == NULL) {
+        root = right;
+        return right_height;
+    }
+
+    KeyType key = separator;
+    if (left_height == right_height) {
+        if (CanMerge(left, right)) {
+            MergeNodes(left, key, right);
+            root = left;
+            return left_height;
+        }
+        // Both become children of a new root, even them out if needed
+        if (left->key_num < MIN_KEY_NUM || right->key_num < MIN_KEY_NUM) {
+            RedistributeNodes(left, key, right);
+        }
+        InternalNode *new_root_node = NewInternalNode();
+        new_root_node->keys[0] = key;
+        new_root_node->key_num = 1;
+        new_root_node->children[0] = left;
+        new_root_node->children[1] = right;
+#if ORDER_STATISTICS
+        RecountNode(new_root_node);
+#endif
+        root = new_root_node;
+        return left_height+1;
+    }
+
+    // Walk down the inner spine of the taller tree to the level just above
+    // the shorter one
+    bool left_taller = left_height > right_height;
+    Node *shorter = left_taller ? right : left;
+    root = left_taller ? left : right;
+    NodePath path;
+    InternalNode *parent_node = (InternalNode*) root;
+    for (int h=max(left_height, right_height); ; h--) {
+        int i = left_taller ? parent_node->key_num : 0;
+        path.push_back(make_pair(parent_node, i));
+        if (h == min(left_height, right_height)+1) {
+            break;
+        }
+        parent_node = (InternalNode*) parent_node->children[i];
+    }
+#if ORDER_STATISTICS
+    // Nodes above the attach point simply gain the shorter tree's keys
+    int count = SubtreeCount(shorter);
+    for (size_t level=0; level+1<path.size(); level++) {
+        path[level].first->child_counts[path[level].second] += count;
+    }
+#endif
+
+    // Fix the seam against the neighbouring child before hanging the tree
+    int sibling_pos = path.back().second;
+    Node *sibling = parent_node->children[sibling_pos];
+    Node *seam_left = left_taller ? sibling : shorter;
+    Node *seam_right = left_taller ? shorter : sibling;
+    if (CanMerge(seam_left, seam_right)) {
+        MergeNodes(seam_left, key, seam_right);
+        parent_node->children[sibling_pos] = seam_left;
+#if ORDER_STATISTICS
+        RecountNode(parent_node);
+#endif
+    } else {
+        if (shorter->key_num < MIN_KEY_NUM) {
+            RedistributeNodes(seam_left, key, seam_right);
+        }
+        InsertInParent(key, path, path.size()-1, shorter, left_taller ? sibling_pos+1 : 0);
+    }
+    return Height(root);
+}
+
+// Number of levels below and including the node
+int BPlusTree::Height(Node *node) {
+    int height = 0;
+    for (; node != NULL; height++) {
+        node = node->is_leaf ? NULL : ((InternalNode*) node)->children[0];
+    }
+    return height;
+}
+
+LeafNode* BPlusTree::FirstLeaf(Node *node) {
+    while (!node->is_leaf) {
+        node = ((InternalNode*) node)->children[0];
+    }
+    return (LeafNode*) node;
+}
+
+LeafNode* BPlusTree::LastLeaf(Node *node) {
+    while (!node->is_leaf) {
+        node = ((InternalNode*) node)->children[node->key_num];
+    }
+    return (LeafNode*) node;
+}
+
+// Copy the subtree into nodes of this tree, chaining the copied leaves
+Node* BPlusTree::CloneSubtree(Node *node, LeafNode *&last_leaf) {
+    if (node->is_leaf) {
+        LeafNode *leaf_node = NewLeafNode();
+        *leaf_node = *(LeafNode*) node;
+        leaf_node->next_leaf = NULL;
+        leaf_node->prev_leaf = last_leaf;
+        if (last_leaf) {
+            last_leaf->next_leaf = leaf_node;
+        }
+        last_leaf = leaf_node;
+        return leaf_node;
+    }
+    InternalNode *internal_node = NewInternalNode();
+    *internal_node = *(InternalNode*) node;
+    for (int i=0; i<internal_node->key_num+1; i++) {
+        internal_node->children[i] = CloneSubtree(internal_node->children[i], last_leaf);
+    }
+    return internal_node;
+}
+
+/*****************************************************************************
+ * COMPACTION
+ *****************************************************************************/
+/*
+ * Incremental compaction of sparse nodes.
+ * Each call walks the leaf chain from where the last one stopped, one bottom
+ * internal node at a time: its leaves are repacked to target_fill, it
+ * absorbs right siblings whose leaves fit, and the internal nodes above it
+ * are merged with their right siblings where they fit. The root is dropped
+ * while it has a single child. Work per call is bounded by max_leaves (plus
+ * the leaves of the last group), so it can be scheduled between requests.
+ * @return: true if this call finished a pass over the whole tree
+ */
+bool BPlusTree::Compact(const int &max_leaves, const double &target_fill, CompactionStats &stats) {
+    long long start_nodes = freed_nodes, start_bytes = freed_bytes;
+    int start_height = Height(root);
+
+    // Keys per leaf to aim for, never below what a non-root node must hold
+    int target_keys = (int) (target_fill * (MAX_FANOUT-1) + 0.5);
+    target_keys = max(target_keys, max(MIN_KEY_NUM, 1));
+    target_keys = min(target_keys, MAX_FANOUT-1);
+
+    bool finished = false;
+    int visited = 0;
+    while (!finished && visited < max_leaves) {
+        // A single leaf has nothing to merge with
+        if (IsEmpty() || root->is_leaf) {
+            finished = true;
+            break;
+        }
+        // Any key of a leaf routes back to it, order within it does not matter
+        if (!compact_in_pass) {
+            compact_cursor = FirstLeaf(root)->keys[0];
+            compact_in_pass = true;
+        }
+
+        NodePath path;
+        FindLeaf(compact_cursor, path);
+        InternalNode *parent_node = path.back().first;
+        path.pop_back();
+        visited += parent_node->key_num+1;
+        LeafNode *last_leaf = RepackLeaves(parent_node, target_keys);
+
+        // Pull in right siblings while their leaves fit into this node
+        while (!path.empty()) {
+            InternalNode *grand_node = path.back().first;
+            int idx = path.back().second;
+            if (idx == grand_node->key_num || !CanMerge(parent_node, grand_node->children[idx+1])) {
+                break;
+            }
+            visited += grand_node->children[idx+1]->key_num+1;
+            FixUnderflow(grand_node, idx+1);
+            last_leaf = RepackLeaves(parent_node, target_keys);
+        }
+        CompactPath(path, parent_node);
+
+        // Continue after the last leaf of this group
+        if (last_leaf->next_leaf == NULL) {
+            finished = true;
+        } else {
+            compact_cursor = last_leaf->next_leaf->keys[0];
+        }
+    }
+
+    if (finished) {
+        compact_in_pass = false;
+        stats.passes++;
+    }
+    stats.leaves_visited += visited;
+    stats.nodes_reclaimed += freed_nodes - start_nodes;
+    stats.bytes_reclaimed += freed_bytes - start_bytes;
+    stats.height_reduction += start_height - Height(root);
+    return finished;
+}
+
+/*
+ * Spread the entries of all leaves below the node evenly over as few leaves
+ * as target_keys allows and release the leaves left over.
+ * @return: the last leaf below the node
+ */
+LeafNode* BPlusTree::RepackLeaves(InternalNode *parent_node, int target_keys) {
+    int child_num = parent_node->key_num+1;
+    std::vector<KeyType> temp_keys;
+    std::vector<RecordPointer> temp_records;
+    for (int i=0; i<child_num; i++) {
+        LeafNode *leaf_node = (LeafNode*) parent_node->children[i];
+        SortLeaf(leaf_node);
+        for (int j=0; j<leaf_node->key_num; j++) {
+            temp_keys.push_back(leaf_node->keys[j]);
+            temp_records.push_back(leaf_node->pointers[j]);
+        }
+    }
+
+    int total = temp_keys.size();
+    int new_num = max(1, (total + target_keys - 1) / target_keys);
+    if (new_num >= child_num) {
+        return (LeafNode*) parent_node->children[child_num-1];
+    }
+
+    // Refill the first new_num leaves, the first total % new_num get one extra
+    int next = 0;
+    for (int i=0; i<new_num; i++) {
+        LeafNode *leaf_node = (LeafNode*) parent_node->children[i];
+        leaf_node->key_num = total/new_num + (i < total%new_num ? 1 : 0);
+        for (int j=0; j<leaf_node->key_num; j++, next++) {
+            leaf_node->keys[j]      = temp_keys[next];
+            leaf_node->pointers[j]  = temp_records[next];
+        }
+        RefreshFingerprints(leaf_node);
+        if (i > 0) {
+            parent_node->keys[i-1] = leaf_node->keys[0];
+        }
+    }
+
+    // Unlink and release the leaves that are no longer needed
+    LeafNode *last_leaf = (LeafNode*) parent_node->children[new_num-1];
+    LeafNode *after_leaf = ((LeafNode*) parent_node->children[child_num-1])->next_leaf;
+    for (int i=new_num; i<child_num; i++) {
+        FreeNode(parent_node->children[i]);
+    }
+    last_leaf->next_leaf = after_leaf;
+    if (after_leaf) {
+        after_leaf->prev_leaf = last_leaf;
+    }
+    parent_node->key_num = new_num-1;
+#if ORDER_STATISTICS
+    RecountNode(parent_node);
+#endif
+    return last_leaf;
+}
+
+/*
+ * Walk up from the node: fix it if it is under-filled, otherwise merge it
+ * with its right sibling when both fit into one node. Then drop single-child
+ * roots.
+ */
+void BPlusTree::CompactPath(NodePath &path, Node *node) {
+    for (int level=path.size()-1; level>=0; level--) {
+        InternalNode *parent_node = path[level].first;
+        int idx = path[level].second;
+        if (node->key_num < MIN_KEY_NUM) {
+            FixUnderflow(parent_node, idx);
+        } else if (idx < parent_node->key_num && CanMerge(node, parent_node->children[idx+1])) {
+            FixUnderflow(parent_node, idx+1);
+        }
+        node = parent_node;
+    }
+    ShrinkRoot();
+}
+
 /*****************************************************************************
  * RANGE_SCAN
  *****************************************************************************/
@@ -338,12 +1215,21 @@ void BPlusTree::Remove(const KeyType &key) {
  */
 void BPlusTree::RangeScan(const KeyType &key_start, const KeyType &key_end,
                           std::vector<RecordPointer> &result) {
-    
+    if (recorder != NULL) {
+        recorder->RecordRangeScan(key_start, key_end);
+    }
+    // Nothing to scan in an empty tree
+    if (IsEmpty()) {
+        return;
+    }
+
     // Find the leaf node that contains the start key
     LeafNode* leaf_node = FindNode((InternalNode*) root, key_start);
 
     // Iterate until we reach end of leaf nodes
     while (leaf_node != NULL) {
+        // The scan stops at the first key past the range, so it needs order
+        SortLeaf(leaf_node);
         int i;
         // Iterate the leaf node keys and store the pointers in result for the keys within the given range
         for (i=0; i<leaf_node->key_num; i++) {
@@ -356,7 +1242,7 @@ void BPlusTree::RangeScan(const KeyType &key_start, const KeyType &key_end,
             }
         }
         // If end key is reached then break out of the loop
-        if (leaf_node->keys[i] > key_end) {
+        if (i < leaf_node->key_num) {
             break;
         }
         // Else move to the next leaf node
@@ -364,6 +1250,85 @@ void BPlusTree::RangeScan(const KeyType &key_start, const KeyType &key_end,
     }
 }
 
+/*
+ * RangeScan with the filter pushed down. The in-range entries of consecutive
+ * leaves are gathered into batches of SCAN_BATCH rows so the predicates run
+ * on full SIMD vectors whatever the fanout, and only the selected rows are
+ * copied into the columns the caller asked for.
+ */
+int BPlusTree::FilteredScan(const KeyType &key_start, const KeyType &key_end,
+                            const ScanFilter &filter, ScanColumns &columns) {
+    if (recorder != NULL) {
+        // Traced as a plain scan, it visits the same leaves
+        recorder->RecordRangeScan(key_start, key_end);
+    }
+    columns.rows = 0;
+    columns.truncated = false;
+    // Nothing to scan in an empty tree
+    if (IsEmpty()) {
+        return 0;
+    }
+
+    ScanFilterEvaluator evaluator(filter);
+    KeyType batch_keys[SCAN_BATCH];
+    RecordPointer batch_pointers[SCAN_BATCH];
+    LeafNode* leaf_node = FindNode((InternalNode*) root, key_start);
+    SortLeaf(leaf_node);
+    int position = 0;
+
+    while (true) {
+        // Gather the next batch from the leaf chain
+        int batch_num = 0;
+        while (leaf_node != NULL && batch_num < SCAN_BATCH) {
+            if (position == leaf_node->key_num) {
+                leaf_node = leaf_node->next_leaf;
+                position = 0;
+                if (leaf_node != NULL) {
+                    SortLeaf(leaf_node);
+                }
+                continue;
+            }
+            if (leaf_node->keys[position] >= key_end) {
+                leaf_node = NULL;
+                break;
+            }
+            if (leaf_node->keys[position] >= key_start) {
+                batch_keys[batch_num]       = leaf_node->keys[position];
+                batch_pointers[batch_num]   = leaf_node->pointers[position];
+                batch_num++;
+            }
+            position++;
+        }
+        if (batch_num == 0) {
+            break;
+        }
+        // The evaluator reads whole groups of 4 rows
+        for (int i=batch_num; i%4 != 0; i++) {
+            batch_keys[i]       = KeyType();
+            batch_pointers[i]   = RecordPointer();
+        }
+
+        // Copy the selected rows out, stopping when the columns are full
+        unsigned long long selected = evaluator.Evaluate(batch_keys, batch_pointers, batch_num);
+        for (; selected != 0; selected &= selected-1) {
+            int i = __builtin_ctzll(selected);
+            if (columns.rows == columns.capacity) {
+                columns.truncated = true;
+                columns.next_key = batch_keys[i];
+                return columns.rows;
+            }
+            if (columns.keys != NULL) {
+                columns.keys[columns.rows] = batch_keys[i];
+            }
+            if (columns.pointers != NULL) {
+                columns.pointers[columns.rows] = batch_pointers[i];
+            }
+            columns.rows++;
+        }
+    }
+    return columns.rows;
+}
+
 LeafNode* BPlusTree::FindNode(InternalNode* curr_node, const KeyType &key_start) {
     
     // Iterate till we reach the leaf node
@@ -377,3 +1342,183 @@ LeafNode* BPlusTree::FindNode(InternalNode* curr_node, const KeyType &key_start)
     
     return (LeafNode*) curr_node;
 }
+
+/*****************************************************************************
+ * STATISTICS
+ *****************************************************************************/
+void BPlusTree::GetStats(TreeStats &stats) {
+    stats = TreeStats();
+    if (IsEmpty()) {
+        return;
+    }
+    stats.height = Height(root);
+    CollectStats(root, stats);
+    stats.leaf_fill = (double) stats.keys / (stats.leaf_nodes * (MAX_FANOUT-1));
+}
+
+void BPlusTree::CollectStats(Node *node, TreeStats &stats) {
+    if (node->is_leaf) {
+        stats.keys += node->key_num;
+        stats.leaf_nodes++;
+        stats.node_bytes += sizeof(LeafNode);
+        return;
+    }
+    stats.internal_nodes++;
+    stats.node_bytes += sizeof(InternalNode);
+    for (int i=0; i<node->key_num+1; i++) {
+        CollectStats(((InternalNode*) node)->children[i], stats);
+    }
+}
+
+/*****************************************************************************
+ * ORDER STATISTICS
+ *****************************************************************************/
+/*
+ * With ORDER_STATISTICS every internal node knows how many keys live below
+ * each of its children, so ranks are summed up on the way down a single
+ * root-to-leaf path. Without it we fall back to walking the leaf chain.
+ */
+#if ORDER_STATISTICS
+int BPlusTree::SubtreeCount(Node *node) {
+    if (node->is_leaf) {
+        return node->key_num;
+    }
+    InternalNode *internal_node = (InternalNode*) node;
+    int count = 0;
+    for (int i=0; i<internal_node->key_num+1; i++) {
+        count += internal_node->child_counts[i];
+    }
+    return count;
+}
+
+void BPlusTree::RecountNode(InternalNode *node) {
+    for (int i=0; i<node->key_num+1; i++) {
+        node->child_counts[i] = SubtreeCount(node->children[i]);
+    }
+}
+
+void BPlusTree::UpdatePathCounts(NodePath &path, int delta) {
+    for (size_t i=0; i<path.size(); i++) {
+        path[i].first->child_counts[path[i].second] += delta;
+    }
+}
+#endif
+
+/*
+ * Return the number of keys strictly smaller than the key
+ */
+int BPlusTree::Rank(const KeyType &key) {
+    if (IsEmpty()) {
+        return 0;
+    }
+
+    int rank = 0;
+#if ORDER_STATISTICS
+    Node *curr_node = root;
+    while (!curr_node->is_leaf) {
+        InternalNode *parent_node = (InternalNode*) curr_node;
+        int i;
+        // Every child left of the path only holds smaller keys
+        for (i=0; i<parent_node->key_num && key>=parent_node->keys[i]; i++) {
+            rank += parent_node->child_counts[i];
+        }
+        curr_node = parent_node->children[i];
+    }
+    LeafNode *leaf_node = (LeafNode*) curr_node;
+    for (int i=0; i<leaf_node->key_num; i++) {
+        if (leaf_node->keys[i] < key) {
+            rank++;
+        }
+    }
+#else
+    int k = 0;
+    LeafNode *leaf_node = FindNodeByRank(k);
+    for (; leaf_node != NULL; leaf_node = leaf_node->next_leaf) {
+        for (int i=0; i<leaf_node->key_num; i++) {
+            if (leaf_node->keys[i] < key) {
+                rank++;
+            }
+        }
+    }
+#endif
+    return rank;
+}
+
+/*
+ * Return the k-th smallest key and its value, counting from 0
+ * @return : false if the tree holds k keys or less
+ */
+bool BPlusTree::Select(const int &k, KeyType &key, RecordPointer &value) {
+    int position = k;
+    LeafNode *leaf_node = FindNodeByRank(position);
+    if (leaf_node == NULL) {
+        return false;
+    }
+    SortLeaf(leaf_node);
+    key = leaf_node->keys[position];
+    value = leaf_node->pointers[position];
+    return true;
+}
+
+/*
+ * Return the number of keys within [key_start, key_end), the same range
+ * RangeScan would return
+ */
+int BPlusTree::CountRange(const KeyType &key_start, const KeyType &key_end) {
+    if (key_start >= key_end) {
+        return 0;
+    }
+    return Rank(key_end) - Rank(key_start);
+}
+
+/*
+ * Offset pagination: jump straight to the offset-th key and return the
+ * values of the next limit keys in key order
+ */
+void BPlusTree::SelectScan(const int &offset, const int &limit, std::vector<RecordPointer> &result) {
+    int position = offset;
+    LeafNode *leaf_node = FindNodeByRank(position);
+    int remaining = limit;
+    while (leaf_node != NULL && remaining > 0) {
+        SortLeaf(leaf_node);
+        for (; position<leaf_node->key_num && remaining>0; position++, remaining--) {
+            result.push_back(leaf_node->pointers[position]);
+        }
+        leaf_node = leaf_node->next_leaf;
+        position = 0;
+    }
+}
+
+LeafNode* BPlusTree::FindNodeByRank(int &k) {
+    if (IsEmpty() || k < 0) {
+        return NULL;
+    }
+
+    Node *curr_node = root;
+#if ORDER_STATISTICS
+    // Skip whole children until the one holding the k-th key
+    while (!curr_node->is_leaf) {
+        InternalNode *parent_node = (InternalNode*) curr_node;
+        int i;
+        for (i=0; i<parent_node->key_num && k>=parent_node->child_counts[i]; i++) {
+            k -= parent_node->child_counts[i];
+        }
+        curr_node = parent_node->children[i];
+    }
+    if (k >= curr_node->key_num) {
+        return NULL;
+    }
+    return (LeafNode*) curr_node;
+#else
+    // Walk down the leftmost branch and count along the leaf chain
+    while (!curr_node->is_leaf) {
+        curr_node = ((InternalNode*) curr_node)->children[0];
+    }
+    LeafNode *leaf_node = (LeafNode*) curr_node;
+    while (leaf_node != NULL && k >= leaf_node->key_num) {
+        k -= leaf_node->key_num;
+        leaf_node = leaf_node->next_leaf;
+    }
+    return leaf_node;
+#endif
+}
@@ -0,0 +1,293 @@
+#include "include/hot_key_cache.h"
+
+namespace {
+// Keeps the bucket index independent of the sketch positions
+const unsigned long long SKETCH_SALT = 0x9e3779b97f4a7c15ULL;
+// Sketch counters per cache slot in every row
+const size_t SKETCH_WIDTH_FACTOR = 4;
+// Counters are halved after this many lookups per cache slot, a power of
+// two so the period check needs no division
+const long long SKETCH_PERIOD_FACTOR = 8;
+// Doorkeeper bits per lookup of a period
+const long long DOORKEEPER_BITS_FACTOR = 8;
+
+// 64-bit finalizer of MurmurHash3
+inline unsigned long long Mix(unsigned long long x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+size_t RoundUpPowerOfTwo(size_t n) {
+    size_t power = 1;
+    while (power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+}
+
+HotKeyCache::HotKeyCache(size_t capacity) {
+    slot_num = RoundUpPowerOfTwo(capacity < HOT_CACHE_WAYS ? HOT_CACHE_WAYS : capacity);
+    bucket_mask = slot_num / HOT_CACHE_WAYS - 1;
+    slots.reset(new Slot[slot_num]);
+    for (size_t i=0; i<slot_num; i++) {
+        slots[i].version.store(0);
+        slots[i].valid.store(false);
+        slots[i].key.store(KeyType());
+        slots[i].page_id.store(0);
+        slots[i].record_id.store(0);
+    }
+
+    size_t width = slot_num * SKETCH_WIDTH_FACTOR;
+    sketch_mask = width - 1;
+    sketch.reset(new std::atomic<unsigned char>[width * HOT_CACHE_SKETCH_ROWS]);
+    for (size_t i=0; i<width * HOT_CACHE_SKETCH_ROWS; i++) {
+        sketch[i].store(0);
+    }
+    sketch_period = SKETCH_PERIOD_FACTOR * (long long) slot_num;
+
+    size_t doorkeeper_words = RoundUpPowerOfTwo(DOORKEEPER_BITS_FACTOR * sketch_period / 64);
+    doorkeeper_mask = doorkeeper_words * 64 - 1;
+    doorkeeper.reset(new std::atomic<unsigned long long>[doorkeeper_words]);
+    for (size_t i=0; i<doorkeeper_words; i++) {
+        doorkeeper[i].store(0);
+    }
+
+    lookups.store(0);
+    hits.store(0);
+    admissions.store(0);
+    rejections.store(0);
+    invalidations.store(0);
+}
+
+/*****************************************************************************
+ * FREQUENCY SKETCH
+ *****************************************************************************/
+/*
+ * The first lookup of a key in a period only sets its two doorkeeper bits.
+ * Later ones go to a count-min sketch with conservative update: only the
+ * counters equal to the current estimate are raised, which keeps collisions
+ * from inflating it. Racing lookups may lose an increment, the estimate
+ * only needs to be close.
+ */
+void HotKeyCache::CountLookup(unsigned long long hash) {
+    size_t low = (size_t) hash, high = (size_t) (hash >> 32);
+    if (!InDoorkeeper(low, high)) {
+        size_t first = low & doorkeeper_mask, second = high & doorkeeper_mask;
+        doorkeeper[first / 64].fetch_or(1ULL << (first % 64), std::memory_order_relaxed);
+        doorkeeper[second / 64].fetch_or(1ULL << (second % 64), std::memory_order_relaxed);
+        return;
+    }
+
+    std::atomic<unsigned char> *counters[HOT_CACHE_SKETCH_ROWS];
+    unsigned char minimum = 255;
+    for (int row=0; row<HOT_CACHE_SKETCH_ROWS; row++) {
+        counters[row] = &sketch[row * (sketch_mask + 1) + ((low + row * high) & sketch_mask)];
+        unsigned char count = counters[row]->load(std::memory_order_relaxed);
+        minimum = count < minimum ? count : minimum;
+    }
+    if (minimum == 255) {
+        return;
+    }
+    for (int row=0; row<HOT_CACHE_SKETCH_ROWS; row++) {
+        if (counters[row]->load(std::memory_order_relaxed) == minimum) {
+            counters[row]->store(minimum + 1, std::memory_order_relaxed);
+        }
+    }
+}
+
+int HotKeyCache::Frequency(unsigned long long hash) const {
+    size_t low = (size_t) hash, high = (size_t) (hash >> 32);
+    if (!InDoorkeeper(low, high)) {
+        return 0;
+    }
+    int minimum = 255;
+    for (int row=0; row<HOT_CACHE_SKETCH_ROWS; row++) {
+        int count = sketch[row * (sketch_mask + 1) + ((low + row * high) & sketch_mask)].load(
+                std::memory_order_relaxed);
+        minimum = count < minimum ? count : minimum;
+    }
+    return minimum + 1;
+}
+
+unsigned long long HotKeyCache::SketchHash(const KeyType &key) {
+    return Mix((unsigned long long) (unsigned int) key ^ SKETCH_SALT);
+}
+
+bool HotKeyCache::InDoorkeeper(size_t low, size_t high) const {
+    size_t first = low & doorkeeper_mask, second = high & doorkeeper_mask;
+    return (doorkeeper[first / 64].load(std::memory_order_relaxed) >> (first % 64) & 1) &&
+           (doorkeeper[second / 64].load(std::memory_order_relaxed) >> (second % 64) & 1);
+}
+
+// Halve every counter so keys that stopped being hot lose their standing
+void HotKeyCache::AgeSketch() {
+    for (size_t i=0; i<(sketch_mask + 1) * HOT_CACHE_SKETCH_ROWS; i++) {
+        sketch[i].store(sketch[i].load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+    }
+    for (size_t i=0; i<=doorkeeper_mask / 64; i++) {
+        doorkeeper[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/*****************************************************************************
+ * SLOTS
+ *****************************************************************************/
+HotKeyCache::Slot *HotKeyCache::Bucket(const KeyType &key) {
+    return &slots[(Mix((unsigned long long) (unsigned int) key) & bucket_mask) * HOT_CACHE_WAYS];
+}
+
+/*
+ * Read a slot without locking it. The copy is only used if the version was
+ * even and unchanged around it, i.e. no writer touched the slot meanwhile.
+ */
+bool HotKeyCache::ReadSlot(Slot &slot, KeyType &key, RecordPointer &value) {
+    unsigned int version = slot.version.load(std::memory_order_acquire);
+    if (version & 1) {
+        return false;
+    }
+    bool valid = slot.valid.load(std::memory_order_relaxed);
+    key = slot.key.load(std::memory_order_relaxed);
+    value.page_id = slot.page_id.load(std::memory_order_relaxed);
+    value.record_id = slot.record_id.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return valid && slot.version.load(std::memory_order_relaxed) == version;
+}
+
+// Make the version odd, fails if another writer holds the slot
+bool HotKeyCache::LockSlot(Slot &slot, unsigned int &version) {
+    version = slot.version.load(std::memory_order_relaxed);
+    if ((version & 1) || !slot.version.compare_exchange_strong(version, version + 1,
+                                                              std::memory_order_acquire)) {
+        return false;
+    }
+    // Readers that see any of the following stores also see the odd version
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void HotKeyCache::UnlockSlot(Slot &slot, unsigned int version) {
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+/*****************************************************************************
+ * LOOKUP
+ *****************************************************************************/
+bool HotKeyCache::Lookup(const KeyType &key, RecordPointer &value) {
+    CountLookup(SketchHash(key));
+    if (((lookups.fetch_add(1, std::memory_order_relaxed) + 1) & (sketch_period - 1)) == 0) {
+        AgeSketch();
+    }
+
+    Slot *bucket = Bucket(key);
+    for (int i=0; i<HOT_CACHE_WAYS; i++) {
+        KeyType cached_key;
+        RecordPointer cached_value;
+        if (ReadSlot(bucket[i], cached_key, cached_value) && cached_key == key) {
+            value = cached_value;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Take an empty slot of the bucket if there is one, otherwise replace one
+ * cached key, but only if the new key was looked up more often. Most missed
+ * keys are cold and stop at the doorkeeper without touching the bucket, and
+ * only one cached key is weighed so a miss costs at most two estimates.
+ */
+void HotKeyCache::Admit(const KeyType &key, const RecordPointer &value) {
+    unsigned long long hash = SketchHash(key);
+    int frequency = Frequency(hash);
+    if (frequency < HOT_CACHE_MIN_FREQUENCY) {
+        rejections.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Slot *bucket = Bucket(key);
+    int victim = -1;
+    bool victim_empty = false;
+    KeyType victim_key;
+    for (int i=0; i<HOT_CACHE_WAYS; i++) {
+        KeyType cached_key;
+        RecordPointer cached_value;
+        if (!ReadSlot(bucket[i], cached_key, cached_value)) {
+            // Empty, or being written and not worth waiting for
+            if (!(bucket[i].version.load(std::memory_order_relaxed) & 1)) {
+                victim = i;
+                victim_empty = true;
+                break;
+            }
+            continue;
+        }
+        if (cached_key == key) {
+            // Someone else admitted it already
+            return;
+        }
+        // The candidate's hash picks which cached key it competes with
+        if (victim < 0 || i == (int) ((hash >> 56) % HOT_CACHE_WAYS)) {
+            victim = i;
+            victim_key = cached_key;
+        }
+    }
+    if (victim < 0) {
+        return;
+    }
+    if (!victim_empty && Frequency(SketchHash(victim_key)) >= frequency) {
+        rejections.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Slot &slot = bucket[victim];
+    unsigned int version;
+    if (!LockSlot(slot, version)) {
+        return;
+    }
+    slot.key.store(key, std::memory_order_relaxed);
+    slot.page_id.store(value.page_id, std::memory_order_relaxed);
+    slot.record_id.store(value.record_id, std::memory_order_relaxed);
+    slot.valid.store(true, std::memory_order_relaxed);
+    UnlockSlot(slot, version);
+    admissions.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Unlike admission, invalidation must not be skipped, so it waits for a
+ * writer holding the slot. Writers only hold a slot for a few stores.
+ */
+void HotKeyCache::Invalidate(const KeyType &key) {
+    Slot *bucket = Bucket(key);
+    for (int i=0; i<HOT_CACHE_WAYS; i++) {
+        Slot &slot = bucket[i];
+        unsigned int version;
+        while (!LockSlot(slot, version));
+        if (slot.valid.load(std::memory_order_relaxed) && slot.key.load(std::memory_order_relaxed) == key) {
+            slot.valid.store(false, std::memory_order_relaxed);
+            invalidations.fetch_add(1, std::memory_order_relaxed);
+        }
+        UnlockSlot(slot, version);
+    }
+}
+
+void HotKeyCache::Clear() {
+    for (size_t i=0; i<slot_num; i++) {
+        unsigned int version;
+        while (!LockSlot(slots[i], version));
+        slots[i].valid.store(false, std::memory_order_relaxed);
+        UnlockSlot(slots[i], version);
+    }
+}
+
+void HotKeyCache::GetStats(HotKeyCacheStats &stats) const {
+    stats.lookups = lookups.load(std::memory_order_relaxed);
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.admissions = admissions.load(std::memory_order_relaxed);
+    stats.rejections = rejections.load(std::memory_order_relaxed);
+    stats.invalidations = invalidations.load(std::memory_order_relaxed);
+}
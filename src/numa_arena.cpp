@@ -0,0 +1,112 @@
+#include "include/numa_arena.h"
+#include <cstdlib>
+#include <new>
+#ifdef BPLUSTREE_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace {
+// Size of each slab requested from the operating system
+const size_t SLAB_SIZE = 64 * 1024;
+// Every chunk is aligned for any node type
+const size_t CHUNK_ALIGN = alignof(std::max_align_t);
+
+size_t RoundUp(size_t size) {
+    return (size + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+}
+}
+
+NumaArena::NumaArena(int numa_node) : numa_node(numa_node) {}
+
+NumaArena::~NumaArena() {
+    for (auto &slab : slabs) {
+#ifdef BPLUSTREE_HAVE_NUMA
+        if (slab.second) {
+            numa_free(slab.first, SLAB_SIZE);
+            continue;
+        }
+#endif
+        free(slab.first);
+    }
+}
+
+void *NumaArena::Allocate(size_t size) {
+    size = RoundUp(size);
+    std::lock_guard<std::mutex> guard(latch);
+
+    // Reuse a freed chunk of the same size if there is one
+    for (auto &free_list : free_lists) {
+        if (free_list.first == size && free_list.second != NULL) {
+            void *chunk = free_list.second;
+            free_list.second = *(void **) chunk;
+            return chunk;
+        }
+    }
+
+    // Otherwise carve it out of the current slab, grabbing a new one if needed
+    if (slab_left < size) {
+        void *slab = NULL;
+#ifdef BPLUSTREE_HAVE_NUMA
+        if (Available() && numa_node >= 0) {
+            slab = numa_alloc_onnode(SLAB_SIZE, numa_node);
+        } else if (Available()) {
+            slab = numa_alloc_local(SLAB_SIZE);
+        }
+#endif
+        // Free the slab the same way it was allocated
+        bool from_numa = slab != NULL;
+        if (slab == NULL) {
+            slab = malloc(SLAB_SIZE);
+        }
+        if (slab == NULL) {
+            throw std::bad_alloc();
+        }
+        slabs.push_back(std::make_pair(slab, from_numa));
+        slab_cursor = (char *) slab;
+        slab_left = SLAB_SIZE;
+    }
+    void *chunk = slab_cursor;
+    slab_cursor += size;
+    slab_left -= size;
+    return chunk;
+}
+
+void NumaArena::Free(void *ptr, size_t size) {
+    size = RoundUp(size);
+    std::lock_guard<std::mutex> guard(latch);
+    for (auto &free_list : free_lists) {
+        if (free_list.first == size) {
+            *(void **) ptr = free_list.second;
+            free_list.second = ptr;
+            return;
+        }
+    }
+    *(void **) ptr = NULL;
+    free_lists.push_back(std::make_pair(size, ptr));
+}
+
+bool NumaArena::Available() {
+#ifdef BPLUSTREE_HAVE_NUMA
+    return numa_available() >= 0;
+#else
+    return false;
+#endif
+}
+
+int NumaArena::NodeCount() {
+#ifdef BPLUSTREE_HAVE_NUMA
+    if (Available()) {
+        return numa_num_configured_nodes();
+    }
+#endif
+    return 1;
+}
+
+bool NumaArena::RunOnNode(int numa_node) {
+#ifdef BPLUSTREE_HAVE_NUMA
+    if (Available() && numa_node >= 0) {
+        return numa_run_on_node(numa_node) == 0;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,150 @@
+#include "include/scan_filter.h"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Multiplicative hash used to pick the sampled keys
+const unsigned int SAMPLE_HASH = 2654435761u;
+
+inline unsigned int SampleHash(const KeyType &key, unsigned int seed) {
+    return ((unsigned int) key ^ seed) * SAMPLE_HASH;
+}
+
+#ifdef __SSE2__
+// Low 32 bits of the lane-wise product, SSE2 has no 32-bit multiply
+inline __m128i MulLo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+}
+
+ScanFilterEvaluator::ScanFilterEvaluator(const ScanFilter &filter)
+    : filter(filter), page_set(filter.page_ids) {
+    sort(page_set.begin(), page_set.end());
+    page_set.erase(unique(page_set.begin(), page_set.end()), page_set.end());
+
+    int modulo = filter.key_modulo;
+    if (modulo > 0 && (modulo & (modulo - 1)) == 0) {
+        modulo_mask = modulo - 1;
+    }
+
+    sample_all = filter.sample_rate >= 1.0;
+    if (filter.sample_rate <= 0) {
+        sample_threshold = 0;
+    } else if (!sample_all) {
+        sample_threshold = (unsigned int) (filter.sample_rate * 4294967296.0);
+    }
+}
+
+bool ScanFilterEvaluator::KeepKey(const KeyType &key) const {
+    if (filter.key_mask != 0 && ((unsigned int) key & filter.key_mask) != (filter.key_bits & filter.key_mask)) {
+        return false;
+    }
+    if (filter.key_modulo != 0 && key % filter.key_modulo != filter.key_residue) {
+        return false;
+    }
+    return sample_all || SampleHash(key, filter.sample_seed) < sample_threshold;
+}
+
+bool ScanFilterEvaluator::KeepPointer(const RecordPointer &pointer) const {
+    if (pointer.page_id < filter.page_min || pointer.page_id > filter.page_max) {
+        return false;
+    }
+    return page_set.empty() || binary_search(page_set.begin(), page_set.end(), pointer.page_id);
+}
+
+/*
+ * Evaluate the predicates four rows at a time. Keys are compared directly,
+ * page ids are picked out of the interleaved RecordPointers with a shuffle.
+ * Predicates without a SIMD form, a modulo that is not a power of two or a
+ * large page set, are checked afterwards on the rows still selected.
+ */
+unsigned long long ScanFilterEvaluator::Evaluate(const KeyType *keys, const RecordPointer *pointers,
+                                                 int row_num) const {
+    unsigned long long selected = 0;
+#ifdef __SSE2__
+    if (sizeof(KeyType) == sizeof(int) && sizeof(RecordPointer) == 2 * sizeof(int)) {
+        const __m128i sign = _mm_set1_epi32(INT_MIN);
+        const __m128i key_mask = _mm_set1_epi32(filter.key_mask);
+        const __m128i key_bits = _mm_set1_epi32(filter.key_bits & filter.key_mask);
+        const __m128i modulo_mask = _mm_set1_epi32(this->modulo_mask);
+        const __m128i modulo = _mm_set1_epi32(filter.key_modulo);
+        const __m128i residue = _mm_set1_epi32(filter.key_residue);
+        const __m128i page_min = _mm_set1_epi32(filter.page_min);
+        const __m128i page_max = _mm_set1_epi32(filter.page_max);
+        const __m128i seed = _mm_set1_epi32(filter.sample_seed);
+        const __m128i hash = _mm_set1_epi32(SAMPLE_HASH);
+        // unsigned compare through the signed one by flipping the sign bits
+        const __m128i threshold = _mm_xor_si128(_mm_set1_epi32(sample_threshold), sign);
+        const bool simd_set = !page_set.empty() && page_set.size() <= SCAN_SIMD_SET_MAX;
+
+        for (int base=0; base<row_num; base+=4) {
+            __m128i key = _mm_loadu_si128((const __m128i*) (keys + base));
+            __m128i low = _mm_loadu_si128((const __m128i*) (pointers + base));
+            __m128i high = _mm_loadu_si128((const __m128i*) (pointers + base + 2));
+            __m128i page = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high),
+                                                           _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i keep = _mm_cmpeq_epi32(key, key);
+
+            if (filter.key_mask != 0) {
+                keep = _mm_and_si128(keep, _mm_cmpeq_epi32(_mm_and_si128(key, key_mask), key_bits));
+            }
+            if (this->modulo_mask != 0) {
+                // key & (m-1) is the residue of non-negative keys, negative keys
+                // with a non-zero residue are m below it under C++ rules
+                __m128i rest = _mm_and_si128(key, modulo_mask);
+                __m128i negative = _mm_srai_epi32(key, 31);
+                __m128i nonzero = _mm_andnot_si128(_mm_cmpeq_epi32(rest, _mm_setzero_si128()), negative);
+                rest = _mm_sub_epi32(rest, _mm_and_si128(modulo, nonzero));
+                keep = _mm_and_si128(keep, _mm_cmpeq_epi32(rest, residue));
+            }
+            if (filter.page_min != INT_MIN) {
+                keep = _mm_andnot_si128(_mm_cmplt_epi32(page, page_min), keep);
+            }
+            if (filter.page_max != INT_MAX) {
+                keep = _mm_andnot_si128(_mm_cmpgt_epi32(page, page_max), keep);
+            }
+            if (simd_set) {
+                __m128i member = _mm_setzero_si128();
+                for (size_t i=0; i<page_set.size(); i++) {
+                    member = _mm_or_si128(member, _mm_cmpeq_epi32(page, _mm_set1_epi32(page_set[i])));
+                }
+                keep = _mm_and_si128(keep, member);
+            }
+            if (!sample_all) {
+                __m128i sample = MulLo32(_mm_xor_si128(key, seed), hash);
+                keep = _mm_and_si128(keep, _mm_cmplt_epi32(_mm_xor_si128(sample, sign), threshold));
+            }
+            selected |= (unsigned long long) _mm_movemask_ps(_mm_castsi128_ps(keep)) << base;
+        }
+        if (row_num < SCAN_BATCH) {
+            selected &= (1ULL << row_num) - 1;
+        }
+
+        // Residual predicates on the rows that are left
+        bool residual_modulo = filter.key_modulo != 0 && this->modulo_mask == 0;
+        bool residual_set = !page_set.empty() && !simd_set;
+        if (residual_modulo || residual_set) {
+            for (unsigned long long rest = selected; rest != 0; rest &= rest-1) {
+                int i = __builtin_ctzll(rest);
+                if ((residual_modulo && keys[i] % filter.key_modulo != filter.key_residue) ||
+                    (residual_set && !binary_search(page_set.begin(), page_set.end(), pointers[i].page_id))) {
+                    selected &= ~(1ULL << i);
+                }
+            }
+        }
+        return selected;
+    }
+#endif
+    for (int i=0; i<row_num; i++) {
+        if (KeepKey(keys[i]) && KeepPointer(pointers[i])) {
+            selected |= 1ULL << i;
+        }
+    }
+    return selected;
+}
@@ -0,0 +1,274 @@
+#include "include/sharded_b_plus_tree.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+// Shards smaller than this are never worth rebalancing
+const size_t MIN_REBALANCE_KEYS = 2 * MAX_FANOUT;
+
+BPlusTree *NewTree(const std::shared_ptr<NumaArena> &arena) {
+    if (arena == NULL) {
+        return new BPlusTree();
+    }
+    return new BPlusTree(arena);
+}
+}
+
+ShardedBPlusTree::ShardedBPlusTree(int shard_num, const KeyType &key_min, const KeyType &key_max,
+                                   bool numa_aware) {
+    if (shard_num < 1) {
+        shard_num = 1;
+    }
+    bool use_numa = numa_aware && NumaArena::Available();
+    lower_bounds = new std::atomic<KeyType>[shard_num];
+
+    // Shards on the same NUMA node share one arena, so moving keys between
+    // them never copies nodes
+    if (use_numa) {
+        for (int node=0; node<NumaArena::NodeCount(); node++) {
+            arenas.push_back(std::make_shared<NumaArena>(node));
+        }
+    }
+
+    // Cut the expected key range into equal partitions
+    long long width = (long long) key_max - (long long) key_min;
+    for (int i=0; i<shard_num; i++) {
+        Shard *shard = new Shard();
+        shard->numa_node = use_numa ? i % NumaArena::NodeCount() : -1;
+        shard->tree = NewTree(use_numa ? arenas[shard->numa_node] : NULL);
+        if (i == 0) {
+            shard->lower = std::numeric_limits<KeyType>::min();
+        } else {
+            shard->lower = (KeyType) (key_min + width * i / shard_num);
+        }
+        lower_bounds[i].store(shard->lower);
+        shards.push_back(shard);
+    }
+}
+
+ShardedBPlusTree::~ShardedBPlusTree() {
+    for (Shard *shard : shards) {
+        delete shard->tree;
+        delete shard;
+    }
+    delete[] lower_bounds;
+}
+
+bool ShardedBPlusTree::IsEmpty() {
+    for (Shard *shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->latch);
+        if (!shard->tree->IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*****************************************************************************
+ * ROUTING
+ *****************************************************************************/
+int ShardedBPlusTree::ShardOf(const KeyType &key) {
+    // Find the last shard whose lower bound is not larger than the key
+    int low = 0, high = (int) shards.size() - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (lower_bounds[mid].load(std::memory_order_acquire) <= key) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+bool ShardedBPlusTree::Owns(int shard, const KeyType &key) const {
+    // The next shard's lower bound only changes while both latches are held
+    if (key < shards[shard]->lower) {
+        return false;
+    }
+    return shard == (int) shards.size() - 1 || key < shards[shard+1]->lower;
+}
+
+int ShardedBPlusTree::LockShardFor(const KeyType &key) {
+    // A concurrent rebalance may move the boundary between routing and
+    // latching, in which case we simply route again
+    while (true) {
+        int shard = ShardOf(key);
+        shards[shard]->latch.lock();
+        if (Owns(shard, key)) {
+            return shard;
+        }
+        shards[shard]->latch.unlock();
+    }
+}
+
+size_t ShardedBPlusTree::ShardSize(int shard) {
+    std::lock_guard<std::mutex> guard(shards[shard]->latch);
+    return shards[shard]->key_num;
+}
+
+void ShardedBPlusTree::SetCache(HotKeyCache *cache) {
+    this->cache = cache;
+    for (Shard *shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->latch);
+        shard->tree->SetCache(cache);
+    }
+}
+
+void ShardedBPlusTree::GetStats(TreeStats &stats) {
+    stats = TreeStats();
+    for (Shard *shard : shards) {
+        TreeStats shard_stats;
+        {
+            std::lock_guard<std::mutex> guard(shard->latch);
+            shard->tree->GetStats(shard_stats);
+        }
+        stats.height = std::max(stats.height, shard_stats.height);
+        stats.keys += shard_stats.keys;
+        stats.leaf_nodes += shard_stats.leaf_nodes;
+        stats.internal_nodes += shard_stats.internal_nodes;
+        stats.node_bytes += shard_stats.node_bytes;
+    }
+    if (stats.leaf_nodes > 0) {
+        stats.leaf_fill = (double) stats.keys / (stats.leaf_nodes * (MAX_FANOUT-1));
+    }
+}
+
+/*****************************************************************************
+ * POINT OPERATIONS
+ *****************************************************************************/
+bool ShardedBPlusTree::Insert(const KeyType &key, const RecordPointer &value) {
+    if (recorder != NULL) {
+        recorder->RecordInsert(key, value.page_id, value.record_id);
+    }
+    Shard *shard = shards[LockShardFor(key)];
+    std::lock_guard<std::mutex> guard(shard->latch, std::adopt_lock);
+
+    if (!shard->tree->Insert(key, value)) {
+        return false;
+    }
+    shard->key_num++;
+    return true;
+}
+
+void ShardedBPlusTree::Remove(const KeyType &key) {
+    if (recorder != NULL) {
+        recorder->RecordRemove(key);
+    }
+    Shard *shard = shards[LockShardFor(key)];
+    std::lock_guard<std::mutex> guard(shard->latch, std::adopt_lock);
+
+    // Checking with GetValue would count as a lookup in the shard cache
+    if (shard->tree->Remove(key)) {
+        shard->key_num--;
+    }
+}
+
+bool ShardedBPlusTree::GetValue(const KeyType &key, RecordPointer &result) {
+    if (recorder != NULL) {
+        recorder->RecordGetValue(key);
+    }
+    Shard *shard = shards[LockShardFor(key)];
+    std::lock_guard<std::mutex> guard(shard->latch, std::adopt_lock);
+    return shard->tree->GetValue(key, result);
+}
+
+/*****************************************************************************
+ * RANGE_SCAN
+ *****************************************************************************/
+/*
+ * Scan the shards in key order. The next shard is latched before the current
+ * one is released, so no rebalance can move keys across the shard we are
+ * leaving and every key in the range is seen exactly once.
+ */
+void ShardedBPlusTree::RangeScan(const KeyType &key_start, const KeyType &key_end,
+                                 std::vector<RecordPointer> &result) {
+    if (recorder != NULL) {
+        recorder->RecordRangeScan(key_start, key_end);
+    }
+    if (key_start >= key_end) {
+        return;
+    }
+    int shard = LockShardFor(key_start);
+    while (true) {
+        shards[shard]->tree->RangeScan(key_start, key_end, result);
+
+        // Stop at the last shard or once the range ends before the next one
+        if (shard == (int) shards.size() - 1 || key_end <= shards[shard+1]->lower) {
+            break;
+        }
+        shards[shard+1]->latch.lock();
+        shards[shard]->latch.unlock();
+        shard++;
+    }
+    shards[shard]->latch.unlock();
+}
+
+/*****************************************************************************
+ * REBALANCE
+ *****************************************************************************/
+int ShardedBPlusTree::Rebalance(double skew_ratio) {
+    int moved = 0;
+    for (int i=0; i+1<(int) shards.size(); i++) {
+        if (RebalancePair(i, skew_ratio)) {
+            moved++;
+        }
+    }
+    return moved;
+}
+
+bool ShardedBPlusTree::RebalancePair(int shard, double skew_ratio) {
+    Shard *left = shards[shard];
+    Shard *right = shards[shard+1];
+    // Always latch in shard order, the same order RangeScan uses
+    std::lock_guard<std::mutex> left_guard(left->latch);
+    std::lock_guard<std::mutex> right_guard(right->latch);
+
+    size_t larger = std::max(left->key_num, right->key_num);
+    size_t smaller = std::min(left->key_num, right->key_num);
+    if (larger < MIN_REBALANCE_KEYS || larger <= skew_ratio * std::max(smaller, (size_t) 1)) {
+        return false;
+    }
+
+    // Cut the larger shard so both end up with about the same number of keys.
+    // Split and concatenate only touch one path of each tree.
+    size_t moved = (larger - smaller) / 2;
+    // With a skew ratio of 1 or less, shards one key apart have nothing to move
+    if (moved == 0) {
+        return false;
+    }
+    KeyType boundary;
+    RecordPointer value;
+    if (left->key_num > right->key_num) {
+        // The top of the left shard moves right
+        if (!left->tree->Select(left->key_num - moved, boundary, value)) {
+            return false;
+        }
+        BPlusTree moving;
+        // Keys keep their values when they move, so the cache stays valid
+        moving.SetCache(cache);
+        left->tree->SplitAt(boundary, moving);
+        right->tree->Concatenate(moving);
+        left->key_num -= moved;
+        right->key_num += moved;
+    } else {
+        // The bottom of the right shard moves left, the rest stays behind
+        if (!right->tree->Select(moved, boundary, value)) {
+            return false;
+        }
+        BPlusTree *staying = NewTree(NULL);
+        staying->SetCache(cache);
+        right->tree->SplitAt(boundary, *staying);
+        left->tree->Concatenate(*right->tree);
+        delete right->tree;
+        right->tree = staying;
+        left->key_num += moved;
+        right->key_num -= moved;
+    }
+
+    // Publish the new boundary for routing
+    right->lower = boundary;
+    lower_bounds[shard+1].store(right->lower, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,184 @@
+#include "include/trace.h"
+#include <cstring>
+
+namespace {
+const char TRACE_MAGIC[] = "BPTRACE1";
+const size_t TRACE_MAGIC_SIZE = 8;
+// Records are buffered and written in chunks of this size
+const size_t FLUSH_SIZE = 64 * 1024;
+}
+
+/*****************************************************************************
+ * RECORDER
+ *****************************************************************************/
+TraceRecorder::TraceRecorder(const std::string &path) {
+    start = std::chrono::steady_clock::now();
+    file = fopen(path.c_str(), "wb");
+    if (file != NULL) {
+        fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, file);
+    }
+}
+
+TraceRecorder::~TraceRecorder() {
+    Flush();
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+void TraceRecorder::Flush() {
+    std::lock_guard<std::mutex> guard(latch);
+    if (file != NULL && !buffer.empty()) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        fflush(file);
+    }
+    buffer.clear();
+}
+
+void TraceRecorder::RecordInsert(const KeyType &key, int page_id, int record_id) {
+    std::lock_guard<std::mutex> guard(latch);
+    BeginRecord(TRACE_INSERT);
+    PutSigned(key);
+    PutSigned(page_id);
+    PutSigned(record_id);
+}
+
+void TraceRecorder::RecordGetValue(const KeyType &key) {
+    std::lock_guard<std::mutex> guard(latch);
+    BeginRecord(TRACE_GET_VALUE);
+    PutSigned(key);
+}
+
+void TraceRecorder::RecordRangeScan(const KeyType &key_start, const KeyType &key_end) {
+    std::lock_guard<std::mutex> guard(latch);
+    BeginRecord(TRACE_RANGE_SCAN);
+    PutSigned(key_start);
+    PutSigned((long long) key_end - (long long) key_start);
+}
+
+void TraceRecorder::RecordRemove(const KeyType &key) {
+    std::lock_guard<std::mutex> guard(latch);
+    BeginRecord(TRACE_REMOVE);
+    PutSigned(key);
+}
+
+void TraceRecorder::BeginRecord(TraceOpType type) {
+    if (file != NULL && buffer.size() >= FLUSH_SIZE) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+    // Read under the latch from a monotonic clock, so deltas are never negative
+    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    buffer.push_back((unsigned char) type);
+    PutVarint(now - last_timestamp);
+    last_timestamp = now;
+}
+
+void TraceRecorder::PutVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        buffer.push_back((unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((unsigned char) value);
+}
+
+void TraceRecorder::PutSigned(long long value) {
+    // Zigzag encoding keeps small negative numbers short
+    PutVarint(((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63));
+}
+
+/*****************************************************************************
+ * READER
+ *****************************************************************************/
+TraceReader::TraceReader(const std::string &path) {
+    file = fopen(path.c_str(), "rb");
+    char magic[TRACE_MAGIC_SIZE];
+    if (file != NULL && (fread(magic, 1, TRACE_MAGIC_SIZE, file) != TRACE_MAGIC_SIZE ||
+                         memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0)) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+TraceReader::~TraceReader() {
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+bool TraceReader::Next(TraceOp &op) {
+    if (file == NULL || corrupt) {
+        return false;
+    }
+    int type = fgetc(file);
+    if (type == EOF) {
+        return false;
+    }
+
+    unsigned long long delta;
+    long long key, arg;
+    if (type < TRACE_INSERT || type > TRACE_REMOVE || !GetVarint(delta) || !GetSigned(key)) {
+        corrupt = true;
+        return false;
+    }
+    timestamp += delta;
+    op.type = (TraceOpType) type;
+    op.timestamp = timestamp;
+    op.key = (KeyType) key;
+    op.key_end = op.key;
+    op.page_id = 0;
+    op.record_id = 0;
+
+    if (op.type == TRACE_INSERT) {
+        if (!GetSigned(arg)) {
+            corrupt = true;
+            return false;
+        }
+        op.page_id = (int) arg;
+        if (!GetSigned(arg)) {
+            corrupt = true;
+            return false;
+        }
+        op.record_id = (int) arg;
+    } else if (op.type == TRACE_RANGE_SCAN) {
+        if (!GetSigned(arg)) {
+            corrupt = true;
+            return false;
+        }
+        op.key_end = (KeyType) (key + arg);
+    }
+    return true;
+}
+
+bool TraceReader::ReadAll(std::vector<TraceOp> &ops) {
+    TraceOp op;
+    while (Next(op)) {
+        ops.push_back(op);
+    }
+    return !corrupt;
+}
+
+bool TraceReader::GetVarint(unsigned long long &value) {
+    value = 0;
+    for (int shift=0; shift<64; shift+=7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return false;
+        }
+        value |= (unsigned long long) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReader::GetSigned(long long &value) {
+    unsigned long long encoded;
+    if (!GetVarint(encoded)) {
+        return false;
+    }
+    value = (long long) (encoded >> 1) ^ -(long long) (encoded & 1);
+    return true;
+}
@@ -13,6 +13,7 @@
 #include "../include/test_functions.h"
 #include "../include/para.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -26,6 +27,99 @@ void RunTest(BPlusTree& tree, const vector<int>& insertBatch, const vector<int>&
     testOneCase(tree, insertBatch, deleteBatch, range_l, range_r, range_num);
 }
 
+#if ORDER_STATISTICS
+// Check that the count kept for every child matches the keys below it
+int verifySubtreeCounts(Node *node, bool &valid) {
+    if (node->is_leaf) {
+        return node->key_num;
+    }
+    InternalNode *internal_node = (InternalNode *)node;
+    int count = 0;
+    for (int i = 0; i <= node->key_num; i++) {
+        int child_count = verifySubtreeCounts(internal_node->children[i], valid);
+        if (child_count != internal_node->child_counts[i]) {
+            valid = false;
+        }
+        count += child_count;
+    }
+    return count;
+}
+#endif
+
+// Compare Rank, Select, CountRange and SelectScan against the sorted keys
+void testOrderStatistics(BPlusTree &tree, vector<int> keys) {
+    sort(keys.begin(), keys.end());
+#if ORDER_STATISTICS
+    bool valid = true;
+    if (!tree.IsEmpty() && verifySubtreeCounts(tree.root, valid) != (int)keys.size()) {
+        valid = false;
+    }
+    if (!valid) {
+        cout << "ERROR: Subtree counts are not correct" << endl;
+    }
+#endif
+    for (int i = 0; i < (int)keys.size(); i++) {
+        KeyType key;
+        RecordPointer record;
+        if (tree.Rank(keys[i]) != i || tree.Rank(keys[i] + 1) != i + 1) {
+            cout << "ERROR: Rank() test fail!" << endl;
+            return;
+        }
+        if (!tree.Select(i, key, record) || key != keys[i] || record.page_id != keys[i]) {
+            cout << "ERROR: Select() test fail!" << endl;
+            return;
+        }
+    }
+    KeyType key;
+    RecordPointer record;
+    if (tree.Select(keys.size(), key, record)) {
+        cout << "ERROR: Select() out of range test fail!" << endl;
+    }
+    for (int lo = 0; lo < (int)keys.size(); lo += 7) {
+        for (int hi = lo; hi <= (int)keys.size(); hi += 5) {
+            KeyType key_end = hi < (int)keys.size() ? keys[hi] : keys.back() + 1;
+            if (tree.CountRange(keys[lo], key_end) != hi - lo) {
+                cout << "ERROR: CountRange() test fail!" << endl;
+                return;
+            }
+        }
+    }
+    vector<RecordPointer> page;
+    tree.SelectScan(3, 10, page);
+    for (int i = 0; i < (int)page.size(); i++) {
+        if (page[i].page_id != keys[3 + i]) {
+            cout << "ERROR: SelectScan() test fail!" << endl;
+            return;
+        }
+    }
+    if (page.size() != min((size_t)10, keys.size() > 3 ? keys.size() - 3 : 0)) {
+        cout << "ERROR: SelectScan() test fail!" << endl;
+    }
+}
+
+// Check that the tree holds exactly the given keys and is a valid B+ tree
+bool verifyContents(BPlusTree &tree, vector<int> keys) {
+    sort(keys.begin(), keys.end());
+    vector<RecordPointer> records;
+    if (!keys.empty()) {
+        tree.RangeScan(keys.front(), keys.back() + 1, records);
+    }
+    if (records.size() != keys.size() || tree.IsEmpty() != keys.empty()) {
+        return false;
+    }
+    for (int i = 0; i < (int)keys.size(); i++) {
+        if (records[i].page_id != keys[i]) {
+            return false;
+        }
+    }
+    // verifyTreeProperty expects the root to be an internal node
+    if (!tree.IsEmpty() && !tree.root->is_leaf) {
+        verifyTreeProperty(tree);
+    }
+    testOrderStatistics(tree, keys);
+    return true;
+}
+
 int main() {
   
     // This is a B+Tree delete test program.
@@ -58,5 +152,155 @@ int main() {
     vector<int> deleteBatch_2{3,9,999};
     RunTest(tree_2, insertBatch_2, deleteBatch_2, 34, 500, 6, "B+Tree Test Case 2...");
 
+    // Test Case 3: Order statistics after shuffled insertions, duplicates and deletions.
+    cout << "B+Tree Test Case 3..." << endl;
+    BPlusTree tree_3;
+    vector<int> keys_3;
+    for (int i = 0; i < 300; i++) {
+        keys_3.push_back((i * 37) % 300 * 2);
+    }
+    batchInsert(tree_3, keys_3);
+    if (tree_3.Insert(keys_3[5], RecordPointer(keys_3[5], 0))) {
+        cout << "ERROR: Duplicate Insert() test fail!" << endl;
+    }
+    testOrderStatistics(tree_3, keys_3);
+    for (int i = 0; i < 100; i++) {
+        tree_3.Remove(keys_3.back());
+        keys_3.pop_back();
+    }
+    testOrderStatistics(tree_3, keys_3);
+
+    // Test Case 4: Split at every position and concatenate the halves back.
+    cout << "B+Tree Test Case 4..." << endl;
+    vector<int> keys_4;
+    for (int i = 0; i < 200; i++) {
+        keys_4.push_back(i * 3);
+    }
+    for (int cut = -3; cut <= 603; cut += 7) {
+        BPlusTree tree_4, right_4;
+        batchInsert(tree_4, keys_4);
+        tree_4.SplitAt(cut, right_4);
+        vector<int> left_keys, right_keys;
+        for (int key : keys_4) {
+            (key < cut ? left_keys : right_keys).push_back(key);
+        }
+        if (!verifyContents(tree_4, left_keys) || !verifyContents(right_4, right_keys)) {
+            cout << "ERROR: SplitAt() test fail at " << cut << "!" << endl;
+            break;
+        }
+        // Join them back, alternating which side absorbs the other
+        bool joined = cut % 2 ? tree_4.Concatenate(right_4) : right_4.Concatenate(tree_4);
+        if (!joined || !verifyContents(cut % 2 ? tree_4 : right_4, keys_4)) {
+            cout << "ERROR: Concatenate() test fail at " << cut << "!" << endl;
+            break;
+        }
+    }
+    BPlusTree low_4, high_4;
+    batchInsert(low_4, vector<int>{1, 5, 9});
+    batchInsert(high_4, vector<int>{4, 100});
+    if (low_4.Concatenate(high_4)) {
+        cout << "ERROR: Concatenate() of overlapping trees test fail!" << endl;
+    }
+
+    // Test Case 5: Trees of very different heights and deletions down to empty.
+    cout << "B+Tree Test Case 5..." << endl;
+    BPlusTree big_5, small_5;
+    vector<int> keys_5;
+    for (int i = 0; i < 1000; i++) {
+        keys_5.push_back(i);
+    }
+    batchInsert(big_5, keys_5);
+    batchInsert(small_5, vector<int>{5000, 5001});
+    big_5.Concatenate(small_5);
+    keys_5.push_back(5000);
+    keys_5.push_back(5001);
+    if (!verifyContents(big_5, keys_5)) {
+        cout << "ERROR: Concatenate() of a short tree test fail!" << endl;
+    }
+    for (int i = 0; i < (int)keys_5.size(); i += 2) {
+        big_5.Remove(keys_5[i]);
+    }
+    vector<int> odd_5;
+    for (int i = 1; i < (int)keys_5.size(); i += 2) {
+        odd_5.push_back(keys_5[i]);
+    }
+    if (!verifyContents(big_5, odd_5)) {
+        cout << "ERROR: Remove() test fail!" << endl;
+    }
+    batchDelete(big_5, odd_5);
+    if (!big_5.IsEmpty()) {
+        cout << "ERROR: Remove() of every key test fail!" << endl;
+    }
+
+    // Test Case 6: Compaction in small slices after deleting most keys.
+    cout << "B+Tree Test Case 6..." << endl;
+    BPlusTree tree_6;
+    vector<int> keys_6, kept_6;
+    for (int i = 0; i < 3000; i++) {
+        keys_6.push_back(i);
+    }
+    batchInsert(tree_6, keys_6);
+    for (int key : keys_6) {
+        if (key % 5 == 0) {
+            kept_6.push_back(key);
+        } else {
+            tree_6.Remove(key);
+        }
+    }
+    TreeStats before_6, after_6;
+    tree_6.GetStats(before_6);
+    CompactionStats compaction_6;
+    int slices_6 = 0;
+    while (!tree_6.Compact(8, 1.0, compaction_6)) {
+        slices_6++;
+    }
+    tree_6.GetStats(after_6);
+    if (slices_6 == 0 || compaction_6.passes != 1) {
+        cout << "ERROR: Compact() did not run in slices" << endl;
+    }
+    if (after_6.leaf_nodes >= before_6.leaf_nodes || after_6.leaf_fill <= before_6.leaf_fill) {
+        cout << "ERROR: Compact() did not pack the leaves" << endl;
+    }
+    if (compaction_6.nodes_reclaimed != before_6.leaf_nodes + before_6.internal_nodes -
+                                        after_6.leaf_nodes - after_6.internal_nodes ||
+        compaction_6.bytes_reclaimed != before_6.node_bytes - after_6.node_bytes) {
+        cout << "ERROR: Compact() reclaimed stats are wrong" << endl;
+    }
+    if (!verifyContents(tree_6, kept_6)) {
+        cout << "ERROR: Compact() lost keys" << endl;
+    }
+
+    // Test Case 7: Point lookups after descending inserts and removes, which leave fingerprinted leaves unordered.
+    cout << "B+Tree Test Case 7..." << endl;
+    BPlusTree tree_7;
+    vector<int> keys_7;
+    for (int i = 2000; i > 0; i--) {
+        tree_7.Insert(i, RecordPointer(i, 0));
+    }
+    for (int i = 1; i <= 2000; i++) {
+        if (i % 7 == 3) {
+            if (!tree_7.Remove(i) || tree_7.Remove(i)) {
+                cout << "ERROR: Remove() return value test fail on key " << i << endl;
+            }
+        } else {
+            keys_7.push_back(i);
+        }
+    }
+    for (int i = 0; i <= 2001; i++) {
+        RecordPointer record_7;
+        bool found_7 = tree_7.GetValue(i, record_7);
+        bool expected_7 = i >= 1 && i <= 2000 && i % 7 != 3;
+        if (found_7 != expected_7 || (found_7 && record_7.page_id != i)) {
+            cout << "ERROR: GetValue() test fail on key " << i << endl;
+            break;
+        }
+    }
+    if (tree_7.Insert(keys_7[10], RecordPointer(keys_7[10], 0))) {
+        cout << "ERROR: Duplicate Insert() test fail!" << endl;
+    }
+    if (!verifyContents(tree_7, keys_7)) {
+        cout << "ERROR: Unsorted leaves returned wrong keys" << endl;
+    }
+
     return 0;
 }
@@ -0,0 +1,202 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   test/hot_key_cache_test.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+#include "../include/b_plus_tree.h"
+#include "../include/hot_key_cache.h"
+#include "../include/sharded_b_plus_tree.h"
+#include "../include/para.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+int main() {
+    // Test Case 0: Keys are cached from their second lookup on.
+    cout << "Hot Key Cache Test Case 0..." << endl;
+    {
+        BPlusTree tree;
+        HotKeyCache cache(64);
+        tree.SetCache(&cache);
+        for (int key = 0; key < 1000; key++) {
+            tree.Insert(key, RecordPointer(key, key + 1));
+        }
+        RecordPointer record;
+        for (int round = 0; round < 10; round++) {
+            for (int key = 0; key < 8; key++) {
+                if (!tree.GetValue(key, record) || record.page_id != key || record.record_id != key + 1) {
+                    cout << "ERROR: GetValue() through the cache returned a wrong value" << endl;
+                }
+            }
+        }
+        if (tree.GetValue(5000, record)) {
+            cout << "ERROR: Missing key found through the cache" << endl;
+        }
+        HotKeyCacheStats stats;
+        cache.GetStats(stats);
+        if (stats.lookups != 81 || stats.admissions == 0 || stats.hits < 60 || stats.HitRate() <= 0.7) {
+            cout << "ERROR: Hot keys were not cached, hits " << stats.hits << " of " << stats.lookups << endl;
+        }
+    }
+
+    // Test Case 1: One-off lookups and range scans do not push hot keys out.
+    cout << "Hot Key Cache Test Case 1..." << endl;
+    {
+        BPlusTree tree;
+        HotKeyCache cache(64);
+        tree.SetCache(&cache);
+        for (int key = 0; key < 5000; key++) {
+            tree.Insert(key, RecordPointer(key, 0));
+        }
+        RecordPointer record;
+        for (int round = 0; round < 20; round++) {
+            for (int key = 0; key < 16; key++) {
+                tree.GetValue(key, record);
+            }
+        }
+        // Hot lookups go on while a range scan and a sweep of cold keys run
+        vector<RecordPointer> records;
+        tree.RangeScan(0, 5000, records);
+        HotKeyCacheStats before, after;
+        cache.GetStats(before);
+        for (int key = 16; key < 5000; key++) {
+            tree.GetValue(key, record);
+            tree.GetValue(key % 16, record);
+        }
+        cache.GetStats(after);
+        if (after.lookups - before.lookups != 2 * 4984 || after.hits - before.hits < 4984 * 9 / 10) {
+            cout << "ERROR: A sweep of cold keys evicted the hot keys" << endl;
+        }
+    }
+
+    // Test Case 2: Remove and Insert keep the cache coherent with the tree.
+    cout << "Hot Key Cache Test Case 2..." << endl;
+    {
+        BPlusTree tree;
+        HotKeyCache cache(16);
+        tree.SetCache(&cache);
+        for (int key = 0; key < 100; key++) {
+            tree.Insert(key, RecordPointer(key, 0));
+        }
+        RecordPointer record;
+        for (int round = 0; round < 5; round++) {
+            tree.GetValue(42, record);
+        }
+        tree.Remove(42);
+        if (tree.GetValue(42, record)) {
+            cout << "ERROR: Removed key served from the cache" << endl;
+        }
+        tree.Insert(42, RecordPointer(7, 7));
+        for (int round = 0; round < 5; round++) {
+            if (!tree.GetValue(42, record) || record.page_id != 7) {
+                cout << "ERROR: Reinserted key has a stale value" << endl;
+                break;
+            }
+        }
+    }
+
+    // Test Case 3: Keys split off to another tree are no longer served by the first one.
+    cout << "Hot Key Cache Test Case 3..." << endl;
+    {
+        BPlusTree tree, other;
+        HotKeyCache cache(64);
+        tree.SetCache(&cache);
+        for (int key = 0; key < 200; key++) {
+            tree.Insert(key, RecordPointer(key, 0));
+        }
+        RecordPointer record;
+        for (int round = 0; round < 5; round++) {
+            for (int key = 140; key < 160; key++) {
+                tree.GetValue(key, record);
+            }
+        }
+        tree.SplitAt(100, other);
+        if (tree.GetValue(150, record) || !other.GetValue(150, record)) {
+            cout << "ERROR: SplitAt() left moved keys in the cache" << endl;
+        }
+        tree.Concatenate(other);
+        if (!tree.GetValue(150, record) || record.page_id != 150) {
+            cout << "ERROR: Concatenate() lost keys behind the cache" << endl;
+        }
+    }
+
+    // Test Case 4: Threads share one cache across shards while rewriting their keys.
+    cout << "Hot Key Cache Test Case 4..." << endl;
+    {
+        ShardedBPlusTree sharded(4, 0, 4000);
+        HotKeyCache cache(256);
+        sharded.SetCache(&cache);
+        for (int key = 0; key < 4000; key++) {
+            sharded.Insert(key, RecordPointer(0, key));
+        }
+        std::atomic<int> errors(0);
+        vector<std::thread> workers;
+        for (int t = 0; t < 4; t++) {
+            workers.emplace_back([&, t]() {
+                // Every thread rewrites the hot keys of its own shard
+                vector<int> expected(32, 0);
+                RecordPointer record;
+                for (int i = 0; i < 20000; i++) {
+                    int slot = i % 32;
+                    int key = t * 1000 + slot;
+                    if (i % 97 == 0) {
+                        expected[slot]++;
+                        sharded.Remove(key);
+                        sharded.Insert(key, RecordPointer(expected[slot], key));
+                    }
+                    if (!sharded.GetValue(key, record) || record.page_id != expected[slot]) {
+                        errors++;
+                    }
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        sharded.Rebalance();
+        RecordPointer record;
+        if (errors != 0 || !sharded.GetValue(31, record) || record.record_id != 31) {
+            cout << "ERROR: Concurrent cache test fail with " << errors << " errors" << endl;
+        }
+    }
+
+    // Test Case 5: Remove traffic is not counted as lookups and admits nothing.
+    cout << "Hot Key Cache Test Case 5..." << endl;
+    {
+        ShardedBPlusTree sharded(2, 0, 100);
+        HotKeyCache cache(64);
+        sharded.SetCache(&cache);
+        for (int key = 0; key < 100; key++) {
+            sharded.Insert(key, RecordPointer(key, 0));
+        }
+        for (int i = 0; i < 300; i++) {
+            sharded.Remove(i % 10);
+            sharded.Insert(i % 10, RecordPointer(i, 0));
+        }
+        sharded.Remove(1000);
+        HotKeyCacheStats stats;
+        cache.GetStats(stats);
+        if (stats.lookups != 0 || stats.admissions != 0) {
+            cout << "ERROR: Remove() went through the cache, lookups " << stats.lookups
+                 << " admissions " << stats.admissions << endl;
+        }
+        RecordPointer record;
+        if (!sharded.GetValue(9, record) || record.page_id != 299 || sharded.ShardSize(0) + sharded.ShardSize(1) != 100) {
+            cout << "ERROR: Remove() and Insert() through the shards lost keys" << endl;
+        }
+    }
+
+    return 0;
+}
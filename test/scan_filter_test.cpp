@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   test/scan_filter_test.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+#include "../include/b_plus_tree.h"
+#include "../include/scan_filter.h"
+#include "../include/para.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// Keys -1000..1999 inserted in a scrambled order, page ids cycle through 0..49
+void buildTree(BPlusTree &tree, vector<int> &keys) {
+    for (int i = 0; i < 3000; i++) {
+        keys.push_back((i * 1237) % 3000 - 1000);
+    }
+    for (int key : keys) {
+        tree.Insert(key, RecordPointer((key + 1000) % 50, key));
+    }
+    sort(keys.begin(), keys.end());
+}
+
+// Reference evaluation of the filter, one row at a time
+bool keepRow(const ScanFilter &filter, int key, const RecordPointer &record) {
+    if (filter.key_mask != 0 && ((unsigned int) key & filter.key_mask) != (filter.key_bits & filter.key_mask)) {
+        return false;
+    }
+    if (filter.key_modulo != 0 && key % filter.key_modulo != filter.key_residue) {
+        return false;
+    }
+    if (record.page_id < filter.page_min || record.page_id > filter.page_max) {
+        return false;
+    }
+    if (!filter.page_ids.empty() &&
+        find(filter.page_ids.begin(), filter.page_ids.end(), record.page_id) == filter.page_ids.end()) {
+        return false;
+    }
+    return true;
+}
+
+// Run the scan in chunks of capacity rows and compare with the reference
+bool checkScan(BPlusTree &tree, const vector<int> &keys, int key_start, int key_end,
+               const ScanFilter &filter, int capacity) {
+    vector<int> expected;
+    for (int key : keys) {
+        if (key >= key_start && key < key_end && keepRow(filter, key, RecordPointer((key + 1000) % 50, key))) {
+            expected.push_back(key);
+        }
+    }
+
+    vector<KeyType> key_column(capacity);
+    vector<RecordPointer> pointer_column(capacity);
+    ScanColumns columns;
+    columns.keys = key_column.data();
+    columns.pointers = pointer_column.data();
+    columns.capacity = capacity;
+    vector<int> found;
+    KeyType start = key_start;
+    while (true) {
+        tree.FilteredScan(start, key_end, filter, columns);
+        for (int i = 0; i < columns.rows; i++) {
+            if (pointer_column[i].record_id != key_column[i]) {
+                return false;
+            }
+            found.push_back(key_column[i]);
+        }
+        if (!columns.truncated) {
+            break;
+        }
+        if (columns.rows != capacity || columns.next_key <= start) {
+            return false;
+        }
+        start = columns.next_key;
+    }
+    return found == expected;
+}
+
+int main() {
+    BPlusTree tree;
+    vector<int> keys;
+    buildTree(tree, keys);
+
+    // Test Case 0: Without predicates the scan returns the same rows as RangeScan.
+    cout << "Scan Filter Test Case 0..." << endl;
+    {
+        ScanFilter filter;
+        if (!checkScan(tree, keys, -1000, 2000, filter, 5000) ||
+            !checkScan(tree, keys, -3, 4, filter, 100) ||
+            !checkScan(tree, keys, 5000, 6000, filter, 100)) {
+            cout << "ERROR: Unfiltered scan test fail!" << endl;
+        }
+    }
+
+    // Test Case 1: Key bit mask and modulo, including negative keys.
+    cout << "Scan Filter Test Case 1..." << endl;
+    {
+        ScanFilter mask;
+        mask.key_mask = 0x5;
+        mask.key_bits = 0x4;
+        ScanFilter power_of_two;
+        power_of_two.key_modulo = 8;
+        power_of_two.key_residue = -3;
+        ScanFilter other;
+        other.key_modulo = 7;
+        other.key_residue = 2;
+        if (!checkScan(tree, keys, -1000, 2000, mask, 5000) ||
+            !checkScan(tree, keys, -1000, 2000, power_of_two, 5000) ||
+            !checkScan(tree, keys, -500, 500, other, 5000)) {
+            cout << "ERROR: Key predicate test fail!" << endl;
+        }
+    }
+
+    // Test Case 2: Page id range and page id sets small and large.
+    cout << "Scan Filter Test Case 2..." << endl;
+    {
+        ScanFilter range;
+        range.page_min = 10;
+        range.page_max = 19;
+        ScanFilter small_set;
+        small_set.page_ids = {7, 3, 41, 3};
+        ScanFilter large_set;
+        for (int page = 0; page < 50; page += 3) {
+            large_set.page_ids.push_back(page);
+        }
+        large_set.key_modulo = 2;
+        if (!checkScan(tree, keys, -1000, 2000, range, 5000) ||
+            !checkScan(tree, keys, -1000, 2000, small_set, 5000) ||
+            !checkScan(tree, keys, -1000, 2000, large_set, 5000)) {
+            cout << "ERROR: Page predicate test fail!" << endl;
+        }
+    }
+
+    // Test Case 3: Sampling is repeatable and keeps about the requested fraction.
+    cout << "Scan Filter Test Case 3..." << endl;
+    {
+        ScanFilter filter;
+        filter.sample_rate = 0.25;
+        filter.sample_seed = 17;
+        vector<KeyType> first(3000), second(3000);
+        ScanColumns columns;
+        columns.keys = first.data();
+        columns.capacity = 3000;
+        int first_rows = tree.FilteredScan(-1000, 2000, filter, columns);
+        columns.keys = second.data();
+        int second_rows = tree.FilteredScan(-1000, 2000, filter, columns);
+        if (first_rows != second_rows || !equal(first.begin(), first.begin() + first_rows, second.begin())) {
+            cout << "ERROR: Sampling is not repeatable" << endl;
+        }
+        if (first_rows < 600 || first_rows > 900) {
+            cout << "ERROR: Sampling kept " << first_rows << " of 3000 rows" << endl;
+        }
+        filter.sample_rate = 0;
+        if (tree.FilteredScan(-1000, 2000, filter, columns) != 0) {
+            cout << "ERROR: Zero sample rate kept rows" << endl;
+        }
+    }
+
+    // Test Case 4: Small buffers resume where they stopped, projections leave other columns alone.
+    cout << "Scan Filter Test Case 4..." << endl;
+    {
+        ScanFilter filter;
+        filter.page_min = 5;
+        filter.key_modulo = 3;
+        if (!checkScan(tree, keys, -1000, 2000, filter, 1) ||
+            !checkScan(tree, keys, -999, 1999, filter, 7) ||
+            !checkScan(tree, keys, -1000, 2000, filter, 64)) {
+            cout << "ERROR: Resumed scan test fail!" << endl;
+        }
+
+        vector<RecordPointer> pointers(10);
+        ScanColumns columns;
+        columns.pointers = pointers.data();
+        columns.capacity = 10;
+        tree.FilteredScan(100, 2000, filter, columns);
+        if (columns.rows != 10 || !columns.truncated || pointers[0].record_id != 105) {
+            cout << "ERROR: Pointer projection test fail!" << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   test/sharded_b_plus_tree_test.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+#include "../include/sharded_b_plus_tree.h"
+#include "../include/para.h"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+// Check that every key in [key_start, key_end) can be read back
+bool verifyAllPresent(ShardedBPlusTree &tree, int key_start, int key_end, int step) {
+    for (int key = key_start; key < key_end; key += step) {
+        RecordPointer record;
+        if (!tree.GetValue(key, record) || record.page_id != key) {
+            cout << "ERROR: GetValue Not Found: " << key << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Check that a range scan returns the keys in order without gaps
+bool verifyScan(ShardedBPlusTree &tree, int key_start, int key_end) {
+    vector<RecordPointer> records;
+    tree.RangeScan(key_start, key_end, records);
+    if (records.size() != (size_t) (key_end - key_start)) {
+        return false;
+    }
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].page_id != key_start + (int) i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+
+    // Test Case 0: Keys spread over every shard, scans crossing shard boundaries.
+    cout << "Sharded B+Tree Test Case 0..." << endl;
+    ShardedBPlusTree tree_0(4, 0, 400);
+    if (!tree_0.IsEmpty()) {
+        cout << "ERROR: IsEmpty() test fail!" << endl;
+    }
+    for (int i = 399; i >= 0; i--) {
+        tree_0.Insert(i, RecordPointer(i, i));
+    }
+    if (tree_0.Insert(7, RecordPointer(7, 7))) {
+        cout << "ERROR: Duplicate Insert() test fail!" << endl;
+    }
+    verifyAllPresent(tree_0, 0, 400, 1);
+    if (!verifyScan(tree_0, 50, 350) || !verifyScan(tree_0, 99, 101)) {
+        cout << "ERROR: RangeScan() test fail!" << endl;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (tree_0.ShardSize(i) != 100) {
+            cout << "ERROR: Shard " << i << " holds " << tree_0.ShardSize(i) << " keys" << endl;
+        }
+    }
+    tree_0.Remove(100);
+    tree_0.Remove(1000);
+    RecordPointer temp;
+    if (tree_0.GetValue(100, temp) || tree_0.ShardSize(1) != 99) {
+        cout << "ERROR: Remove() test fail!" << endl;
+    }
+
+    // Test Case 1: All keys land in one shard, rebalance spreads them out.
+    cout << "Sharded B+Tree Test Case 1..." << endl;
+    ShardedBPlusTree tree_1(4, 0, 4000);
+    for (int i = 0; i < 400; i++) {
+        tree_1.Insert(i, RecordPointer(i, i));
+    }
+    int moved = 0;
+    for (int round = 0; round < 8; round++) {
+        moved += tree_1.Rebalance();
+    }
+    if (moved == 0 || tree_1.ShardSize(0) == 400) {
+        cout << "ERROR: Rebalance() did not move any keys" << endl;
+    }
+    verifyAllPresent(tree_1, 0, 400, 1);
+    if (!verifyScan(tree_1, 0, 400)) {
+        cout << "ERROR: RangeScan() after Rebalance() test fail!" << endl;
+    }
+
+    // Test Case 2: Concurrent writers while another thread keeps rebalancing.
+    cout << "Sharded B+Tree Test Case 2..." << endl;
+    ShardedBPlusTree tree_2(8, 0, 1 << 20);
+    vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&tree_2, t]() {
+            for (int i = t; i < 4000; i += 4) {
+                tree_2.Insert(i, RecordPointer(i, i));
+            }
+        });
+    }
+    workers.emplace_back([&tree_2]() {
+        for (int round = 0; round < 50; round++) {
+            tree_2.Rebalance();
+        }
+    });
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    verifyAllPresent(tree_2, 0, 4000, 1);
+    if (!verifyScan(tree_2, 0, 4000)) {
+        cout << "ERROR: Concurrent RangeScan() test fail!" << endl;
+    }
+
+    // Test Case 3: Shards one key apart with a skew ratio of 1 have nothing to move.
+    cout << "Sharded B+Tree Test Case 3..." << endl;
+    ShardedBPlusTree tree_3(2, 0, 100);
+    for (int i = 0; i < 9; i++) {
+        tree_3.Insert(i, RecordPointer(i, i));
+    }
+    for (int i = 50; i < 58; i++) {
+        tree_3.Insert(i, RecordPointer(i, i));
+    }
+    if (tree_3.Rebalance(1.0) != 0 || tree_3.Rebalance(0.5) != 0) {
+        cout << "ERROR: Rebalance() moved a boundary without moving keys" << endl;
+    }
+    if (tree_3.ShardOf(50) != 1 || tree_3.ShardSize(0) != 9 || tree_3.ShardSize(1) != 8) {
+        cout << "ERROR: Rebalance() changed the shards of one key apart" << endl;
+    }
+    verifyAllPresent(tree_3, 0, 9, 1);
+    verifyAllPresent(tree_3, 50, 58, 1);
+    vector<RecordPointer> records_3;
+    tree_3.RangeScan(0, 100, records_3);
+    if (records_3.size() != 17) {
+        cout << "ERROR: RangeScan() after Rebalance(1.0) test fail!" << endl;
+    }
+
+    return 0;
+}
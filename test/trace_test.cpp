@@ -0,0 +1,104 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   test/trace_test.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+#include "../include/b_plus_tree.h"
+#include "../include/trace.h"
+#include "../include/para.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+int main() {
+    const char *path = "bplustree_trace_test.trace";
+
+    // Test Case 0: Every tree operation is recorded in order with its arguments.
+    cout << "Trace Test Case 0..." << endl;
+    {
+        TraceRecorder recorder(path);
+        if (!recorder.IsOpen()) {
+            cout << "ERROR: TraceRecorder could not open " << path << endl;
+            return 0;
+        }
+        BPlusTree tree;
+        tree.SetRecorder(&recorder);
+        RecordPointer record;
+        vector<RecordPointer> records;
+        tree.Insert(-5, RecordPointer(1, 2));
+        tree.Insert(2000000000, RecordPointer(-3, 1 << 30));
+        tree.GetValue(-5, record);
+        tree.RangeScan(-100, 2000000000, records);
+        tree.Remove(-5);
+        tree.SetRecorder(NULL);
+        tree.Insert(7, RecordPointer(7, 7));
+    }
+
+    TraceReader reader(path);
+    vector<TraceOp> ops;
+    if (!reader.IsOpen() || !reader.ReadAll(ops) || ops.size() != 5) {
+        cout << "ERROR: TraceReader test fail!" << endl;
+    } else {
+        if (ops[0].type != TRACE_INSERT || ops[0].key != -5 || ops[0].page_id != 1 || ops[0].record_id != 2) {
+            cout << "ERROR: Insert record test fail!" << endl;
+        }
+        if (ops[1].key != 2000000000 || ops[1].page_id != -3 || ops[1].record_id != 1 << 30) {
+            cout << "ERROR: Large value record test fail!" << endl;
+        }
+        if (ops[2].type != TRACE_GET_VALUE || ops[2].key != -5) {
+            cout << "ERROR: GetValue record test fail!" << endl;
+        }
+        if (ops[3].type != TRACE_RANGE_SCAN || ops[3].key != -100 || ops[3].key_end != 2000000000) {
+            cout << "ERROR: RangeScan record test fail!" << endl;
+        }
+        if (ops[4].type != TRACE_REMOVE || ops[4].key != -5) {
+            cout << "ERROR: Remove record test fail!" << endl;
+        }
+        for (size_t i = 1; i < ops.size(); i++) {
+            if (ops[i].timestamp < ops[i-1].timestamp) {
+                cout << "ERROR: Timestamps are not monotonic" << endl;
+            }
+        }
+    }
+
+    // Test Case 1: A truncated trace yields the complete records before the cut.
+    cout << "Trace Test Case 1..." << endl;
+    FILE *file = fopen(path, "rb");
+    vector<char> bytes;
+    for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+        bytes.push_back((char)c);
+    }
+    fclose(file);
+    file = fopen(path, "wb");
+    fwrite(bytes.data(), 1, bytes.size() - 1, file);
+    fclose(file);
+    TraceReader truncated(path);
+    ops.clear();
+    if (truncated.ReadAll(ops) || ops.size() != 4) {
+        cout << "ERROR: Truncated trace test fail!" << endl;
+    }
+
+    // Test Case 2: Files without the trace header are rejected.
+    cout << "Trace Test Case 2..." << endl;
+    file = fopen(path, "wb");
+    fputs("not a trace", file);
+    fclose(file);
+    TraceReader invalid(path);
+    if (invalid.IsOpen()) {
+        cout << "ERROR: Invalid trace test fail!" << endl;
+    }
+
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,330 @@
+//===----------------------------------------------------------------------===//
+//
+//                         Rutgers CS539 - Database System
+//                         ***DO NOT SHARE PUBLICLY***
+//
+// Identification:   tools/b_plus_tree_replay.cpp
+//
+// Copyright (c) 2023, Rutgers University
+//
+//===----------------------------------------------------------------------===//
+
+/*
+ * Replay a workload trace recorded with TraceRecorder.
+ *
+ * Usage: bplustree-replay <trace> [--threads N] [--shards N] [--paced] [--no-verify]
+ *
+ * With one thread (the default) the ops run in trace order against a
+ * BPlusTree and every result is checked against a std::map applying the same
+ * ops. With more threads the ops run against a ShardedBPlusTree: point ops
+ * are assigned to threads by key, so each key still sees its ops in trace
+ * order, and range scans are spread round-robin. Only the final contents are
+ * checked in that mode since scans race with writers.
+ * --paced sleeps to reproduce the original timing instead of running at full
+ * speed. The exit status is 1 if any check fails.
+ */
+
+#include "../include/b_plus_tree.h"
+#include "../include/sharded_b_plus_tree.h"
+#include "../include/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const char *OP_NAMES[] = {"", "Insert", "GetValue", "RangeScan", "Remove"};
+static const int OP_TYPES = 5;
+
+// Latency histogram with power-of-two buckets in nanoseconds
+struct LatencyHistogram {
+    static const int BUCKETS = 48;
+    long long buckets[BUCKETS] = {0};
+    long long count = 0;
+    long long total = 0;
+    long long max = 0;
+
+    void Add(long long ns) {
+        int bucket = 0;
+        while (bucket < BUCKETS-1 && (1LL << (bucket+1)) <= ns) {
+            bucket++;
+        }
+        buckets[bucket]++;
+        count++;
+        total += ns;
+        max = std::max(max, ns);
+    }
+
+    void Merge(const LatencyHistogram &other) {
+        for (int i = 0; i < BUCKETS; i++) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    // Upper bound of the bucket holding the given percentile
+    long long Percentile(double percentile) const {
+        long long seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= percentile / 100.0 * count) {
+                return std::min(max, (1LL << (i+1)) - 1);
+            }
+        }
+        return max;
+    }
+};
+
+struct Mismatches {
+    long long count = 0;
+
+    void Report(size_t index, const TraceOp &op, const char *what) {
+        if (count++ < 10) {
+            printf("MISMATCH at op %zu (%s key=%d): %s\n", index, OP_NAMES[op.type], op.key, what);
+        }
+    }
+};
+
+typedef map<KeyType, RecordPointer> Reference;
+
+static bool sameRecord(const RecordPointer &a, const RecordPointer &b) {
+    return a.page_id == b.page_id && a.record_id == b.record_id;
+}
+
+// Apply one op to the reference map, returning what the tree should return
+static bool applyReference(Reference &reference, const TraceOp &op) {
+    switch (op.type) {
+    case TRACE_INSERT:
+        return reference.insert(make_pair(op.key, RecordPointer(op.page_id, op.record_id))).second;
+    case TRACE_REMOVE:
+        reference.erase(op.key);
+        return true;
+    case TRACE_GET_VALUE:
+        return reference.count(op.key) > 0;
+    default:
+        return true;
+    }
+}
+
+// Run one op against the index and return its latency in nanoseconds
+template <typename Index>
+static long long runOp(Index &index, const TraceOp &op, bool &found, vector<RecordPointer> &records,
+                       RecordPointer &record) {
+    auto begin = chrono::steady_clock::now();
+    switch (op.type) {
+    case TRACE_INSERT:
+        found = index.Insert(op.key, RecordPointer(op.page_id, op.record_id));
+        break;
+    case TRACE_GET_VALUE:
+        found = index.GetValue(op.key, record);
+        break;
+    case TRACE_RANGE_SCAN:
+        records.clear();
+        index.RangeScan(op.key, op.key_end, records);
+        break;
+    case TRACE_REMOVE:
+        index.Remove(op.key);
+        break;
+    }
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+}
+
+static void printReport(const LatencyHistogram *histograms, double seconds, size_t ops, const TreeStats &stats) {
+    printf("elapsed %.3f s, %.0f ops/s\n", seconds, ops / seconds);
+    printf("%-10s %10s %10s %10s %10s %10s %10s\n", "op", "count", "mean ns", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    for (int type = TRACE_INSERT; type < OP_TYPES; type++) {
+        const LatencyHistogram &histogram = histograms[type];
+        if (histogram.count == 0) {
+            continue;
+        }
+        printf("%-10s %10lld %10lld %10lld %10lld %10lld %10lld\n", OP_NAMES[type], histogram.count,
+               histogram.total / histogram.count, histogram.Percentile(50), histogram.Percentile(90),
+               histogram.Percentile(99), histogram.max);
+    }
+    printf("tree: height %d, keys %lld, leaves %lld, internal nodes %lld, %lld bytes, leaf fill %.2f\n",
+           stats.height, stats.keys, stats.leaf_nodes, stats.internal_nodes, stats.node_bytes, stats.leaf_fill);
+}
+
+static long long replaySingle(const vector<TraceOp> &ops, bool paced, bool verify) {
+    BPlusTree tree;
+    Reference reference;
+    Mismatches mismatches;
+    LatencyHistogram histograms[OP_TYPES];
+    vector<RecordPointer> records;
+    RecordPointer record;
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < ops.size(); i++) {
+        const TraceOp &op = ops[i];
+        if (paced) {
+            this_thread::sleep_until(start + chrono::nanoseconds(op.timestamp - ops[0].timestamp));
+        }
+        bool found = true;
+        histograms[op.type].Add(runOp(tree, op, found, records, record));
+        if (!verify) {
+            continue;
+        }
+
+        bool expected = applyReference(reference, op);
+        if (op.type == TRACE_INSERT && found != expected) {
+            mismatches.Report(i, op, expected ? "insert rejected" : "duplicate accepted");
+        } else if (op.type == TRACE_GET_VALUE && found != expected) {
+            mismatches.Report(i, op, expected ? "key not found" : "missing key found");
+        } else if (op.type == TRACE_GET_VALUE && found && !sameRecord(record, reference[op.key])) {
+            mismatches.Report(i, op, "wrong value");
+        } else if (op.type == TRACE_RANGE_SCAN) {
+            vector<RecordPointer> expected_records;
+            for (auto it = reference.lower_bound(op.key); it != reference.end() && it->first < op.key_end; ++it) {
+                expected_records.push_back(it->second);
+            }
+            bool same = records.size() == expected_records.size();
+            for (size_t j = 0; same && j < records.size(); j++) {
+                same = sameRecord(records[j], expected_records[j]);
+            }
+            if (!same) {
+                mismatches.Report(i, op, "wrong scan result");
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    TreeStats stats;
+    tree.GetStats(stats);
+    printReport(histograms, seconds, ops.size(), stats);
+    if (verify && stats.keys != (long long) reference.size()) {
+        mismatches.Report(ops.size(), ops.back(), "final key count differs");
+    }
+    return mismatches.count;
+}
+
+static long long replaySharded(const vector<TraceOp> &ops, int threads, int shards, bool paced, bool verify) {
+    KeyType key_min = ops[0].key, key_max = ops[0].key;
+    for (const TraceOp &op : ops) {
+        key_min = min(key_min, op.key);
+        key_max = max(key_max, op.key);
+    }
+    ShardedBPlusTree tree(shards, key_min, key_max == key_min ? key_max + 1 : key_max);
+
+    // Point ops stay with the thread owning their key, scans go round-robin
+    vector<vector<size_t>> assigned(threads);
+    for (size_t i = 0; i < ops.size(); i++) {
+        size_t owner = ops[i].type == TRACE_RANGE_SCAN ? i : (unsigned int) ops[i].key * 2654435761u;
+        assigned[owner % threads].push_back(i);
+    }
+
+    vector<LatencyHistogram> histograms(threads * OP_TYPES);
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            vector<RecordPointer> records;
+            RecordPointer record;
+            bool found;
+            for (size_t i : assigned[t]) {
+                const TraceOp &op = ops[i];
+                if (paced) {
+                    this_thread::sleep_until(start + chrono::nanoseconds(op.timestamp - ops[0].timestamp));
+                }
+                histograms[t * OP_TYPES + op.type].Add(runOp(tree, op, found, records, record));
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    LatencyHistogram merged[OP_TYPES];
+    for (int t = 0; t < threads; t++) {
+        for (int type = 0; type < OP_TYPES; type++) {
+            merged[type].Merge(histograms[t * OP_TYPES + type]);
+        }
+    }
+    TreeStats stats;
+    tree.GetStats(stats);
+    printReport(merged, seconds, ops.size(), stats);
+    if (!verify) {
+        return 0;
+    }
+
+    // Per-key order was preserved, so the final contents are deterministic
+    Reference reference;
+    for (const TraceOp &op : ops) {
+        applyReference(reference, op);
+    }
+    Mismatches mismatches;
+    if (stats.keys != (long long) reference.size()) {
+        mismatches.Report(ops.size(), ops.back(), "final key count differs");
+    }
+    for (auto &entry : reference) {
+        RecordPointer record;
+        if (!tree.GetValue(entry.first, record) || !sameRecord(record, entry.second)) {
+            mismatches.Report(ops.size(), ops.back(), "final contents differ");
+            break;
+        }
+    }
+    return mismatches.count;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s <trace> [--threads N] [--shards N] [--paced] [--no-verify]\n", argv[0]);
+        return 2;
+    }
+    int threads = 1, shards = 0;
+    bool paced = false, verify = true;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--shards") == 0 && i+1 < argc) {
+            shards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--paced") == 0) {
+            paced = true;
+        } else if (strcmp(argv[i], "--no-verify") == 0) {
+            verify = false;
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    TraceReader reader(argv[1]);
+    vector<TraceOp> ops;
+    if (!reader.IsOpen()) {
+        printf("Cannot read trace %s\n", argv[1]);
+        return 2;
+    }
+    if (!reader.ReadAll(ops)) {
+        printf("Trace %s is truncated after %zu ops, replaying those\n", argv[1], ops.size());
+    }
+    if (ops.empty()) {
+        printf("Trace %s is empty\n", argv[1]);
+        return 0;
+    }
+
+    printf("trace %s: %zu ops, %s, %s\n", argv[1], ops.size(),
+           threads == 1 ? "single thread" : "multi-threaded", paced ? "original pacing" : "full speed");
+    long long mismatches;
+    if (threads == 1) {
+        mismatches = replaySingle(ops, paced, verify);
+    } else {
+        if (shards <= 0) {
+            shards = 2 * threads;
+        }
+        printf("threads %d, shards %d\n", threads, shards);
+        mismatches = replaySharded(ops, threads, shards, paced, verify);
+    }
+    if (verify) {
+        printf("verify: %s (%lld mismatches)\n", mismatches == 0 ? "ok" : "FAILED", mismatches);
+    }
+    return mismatches == 0 ? 0 : 1;
+}